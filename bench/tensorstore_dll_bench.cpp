@@ -0,0 +1,285 @@
+#include "tensorstore_dll/tensorstore_dll.h"
+#include "tensorstore_dll/version.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Benchmark driver for the tensorstore_dll C API.
+//
+// Runs every combination of data type, chunk shape and codec over a cubic
+// volume, repeats each measurement after warm-up runs, and writes one JSON
+// document with median and p99 timings, throughput and on-disk size.
+//
+// Usage: tensorstore_dll_bench [--size N] [--repeats N] [--warmup N]
+//                              [--output FILE] [--dir DIR] [--quick]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int64_t size = 256;         // Edge length of the cubic volume
+    int repeats = 7;
+    int warmup = 2;
+    std::string output;         // stdout if empty
+    std::string dir = "tensorstore_dll_bench.tmp";
+    bool quick = false;         // One chunk shape and codec per dtype
+};
+
+struct Codec {
+    const char* name;
+    const char* compressor;
+    int level;
+    const char* blosc_cname;
+    int blosc_shuffle;
+};
+
+struct DataTypeInfo {
+    const char* name;
+    TSDataType dtype;
+};
+
+// Parses all of `text` as a number of at least `min`.
+template <typename T>
+bool ParseNumber(const char* text, T min, T* value) {
+    const char* end = text + std::strlen(text);
+    T parsed;
+    auto [ptr, ec] = std::from_chars(text, end, parsed);
+    if (ec != std::errc() || ptr != end || parsed < min) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* value = nullptr;
+        bool valid = true;
+        if (arg == "--quick") {
+            options->quick = true;
+        } else if (arg == "--size" && (value = next())) {
+            valid = ParseNumber<int64_t>(value, 1, &options->size);
+        } else if (arg == "--repeats" && (value = next())) {
+            valid = ParseNumber(value, 1, &options->repeats);
+        } else if (arg == "--warmup" && (value = next())) {
+            valid = ParseNumber(value, 0, &options->warmup);
+        } else if (arg == "--output" && (value = next())) {
+            options->output = value;
+        } else if (arg == "--dir" && (value = next())) {
+            options->dir = value;
+        } else {
+            std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+            return false;
+        }
+        if (!valid) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Total size of all regular files below `path`. A zarr array is a directory,
+// so file_size on the array path itself is meaningless.
+uint64_t DiskBytes(const std::filesystem::path& path) {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(path, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file(ec)) {
+            total += it->file_size(ec);
+        }
+    }
+    return total;
+}
+
+// Smooth gradient plus low-amplitude noise, so codecs see data with a
+// realistic mix of structure and entropy. Values are written as raw bytes
+// of the requested element size.
+std::vector<char> MakeVolume(TSDataType dtype, int64_t size) {
+    const size_t element_size = TSGetDataTypeSize(dtype);
+    const size_t count = static_cast<size_t>(size * size * size);
+    std::vector<char> data(count * element_size);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> noise(0, 15);
+    for (size_t i = 0; i < count; ++i) {
+        const int64_t z = static_cast<int64_t>(i) / (size * size);
+        const int64_t y = (static_cast<int64_t>(i) / size) % size;
+        const int64_t x = static_cast<int64_t>(i) % size;
+        const double value = 100.0 + 50.0 * std::sin(x * 0.05) * std::cos(y * 0.03) + z * 0.5 +
+                             noise(rng);
+        char* dest = data.data() + i * element_size;
+        switch (dtype) {
+            case TS_UINT8: {
+                const uint8_t v = static_cast<uint8_t>(value);
+                std::memcpy(dest, &v, sizeof(v));
+                break;
+            }
+            case TS_UINT16: {
+                const uint16_t v = static_cast<uint16_t>(value * 16);
+                std::memcpy(dest, &v, sizeof(v));
+                break;
+            }
+            case TS_FLOAT32: {
+                const float v = static_cast<float>(value);
+                std::memcpy(dest, &v, sizeof(v));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return data;
+}
+
+// Median and p99 (nearest rank) of the measured durations in seconds.
+nlohmann::json Summarize(std::vector<double> seconds, double bytes) {
+    std::sort(seconds.begin(), seconds.end());
+    const double median = seconds[seconds.size() / 2];
+    const size_t p99_rank = static_cast<size_t>(std::ceil(0.99 * seconds.size()));
+    const double p99 = seconds[std::max<size_t>(p99_rank, 1) - 1];
+    const double mib = bytes / (1024.0 * 1024.0);
+    return {
+        {"seconds", {{"median", median}, {"p99", p99}, {"all", seconds}}},
+        // Throughput at the median and at the p99 (slow tail) duration.
+        {"mib_per_s", {{"median", mib / median}, {"p99", mib / p99}}},
+    };
+}
+
+template <typename Fn>
+std::vector<double> Measure(const Options& options, Fn&& run, bool* ok) {
+    std::vector<double> seconds;
+    for (int i = 0; i < options.warmup + options.repeats && *ok; ++i) {
+        const auto start = Clock::now();
+        *ok = run();
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        if (i >= options.warmup) {
+            seconds.push_back(elapsed.count());
+        }
+    }
+    return seconds;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, &options)) {
+        return 2;
+    }
+
+    const std::vector<DataTypeInfo> dtypes = {
+        {"uint8", TS_UINT8}, {"uint16", TS_UINT16}, {"float32", TS_FLOAT32}};
+    std::vector<std::vector<int64_t>> chunk_shapes = {{32, 32, 32}, {64, 64, 64}, {1, 256, 256}};
+    std::vector<Codec> codecs = {
+        {"none", "none", 0, nullptr, 0},
+        {"zstd-3", "zstd", 3, nullptr, 0},
+        {"blosc-lz4-5", "blosc", 5, "lz4", 1},
+        {"blosc-zstd-3", "blosc", 3, "zstd", 2},
+    };
+    if (options.quick) {
+        chunk_shapes.resize(1);
+        codecs = {codecs[1]};
+    }
+
+    TSContext* context = TSCreateContext();
+    if (!context) {
+        std::cerr << "Failed to create context" << std::endl;
+        return 1;
+    }
+
+    const int64_t shape[] = {options.size, options.size, options.size};
+    const int64_t origin[] = {0, 0, 0};
+    const std::filesystem::path path = options.dir;
+    nlohmann::json results = nlohmann::json::array();
+    bool all_ok = true;
+
+    for (const auto& dtype : dtypes) {
+        const std::vector<char> volume = MakeVolume(dtype.dtype, options.size);
+        const double bytes = static_cast<double>(volume.size());
+        std::vector<char> read_back(volume.size());
+
+        for (const auto& chunk_shape : chunk_shapes) {
+            int64_t chunks[3];
+            for (int i = 0; i < 3; ++i) chunks[i] = std::min(chunk_shape[i], options.size);
+
+            for (const auto& codec : codecs) {
+                TSError error = {nullptr, 0};
+                std::filesystem::remove_all(path);
+                TSDataset* dataset = TSCreateZarrCompressedEx(
+                    context, path.string().c_str(), dtype.dtype, shape, 3, chunks, 0,
+                    codec.compressor, codec.level, codec.blosc_cname, 0, codec.blosc_shuffle, 1,
+                    &error);
+
+                nlohmann::json scenario = {
+                    {"dtype", dtype.name},
+                    {"chunk_shape", {chunks[0], chunks[1], chunks[2]}},
+                    {"codec", codec.name},
+                    {"uncompressed_bytes", volume.size()},
+                };
+                bool ok = dataset != nullptr;
+                if (ok) {
+                    auto write = Measure(options, [&]() {
+                        return TSWrite(dataset, origin, shape, dtype.dtype, volume.data(),
+                                       &error) == 0;
+                    }, &ok);
+                    const uint64_t disk_bytes = DiskBytes(path);
+                    auto read = Measure(options, [&]() {
+                        return TSRead(dataset, origin, shape, dtype.dtype, read_back.data(),
+                                      &error) == 0;
+                    }, &ok);
+                    if (ok && read_back != volume) {
+                        scenario["error"] = "Read data does not match written data";
+                        ok = false;
+                    }
+                    if (ok) {
+                        scenario["write"] = Summarize(write, bytes);
+                        scenario["read"] = Summarize(read, bytes);
+                        scenario["disk_bytes"] = disk_bytes;
+                        scenario["compression_ratio"] =
+                            disk_bytes > 0 ? bytes / static_cast<double>(disk_bytes) : 0.0;
+                    }
+                    TSCloseDataset(dataset);
+                }
+                if (error.message) {
+                    scenario["error"] = error.message;
+                    TSClearError(&error);
+                }
+                all_ok = all_ok && ok;
+                std::cerr << dtype.name << " " << chunks[0] << "x" << chunks[1] << "x"
+                          << chunks[2] << " " << codec.name << (ok ? " done" : " FAILED")
+                          << std::endl;
+                results.push_back(std::move(scenario));
+            }
+        }
+    }
+    std::filesystem::remove_all(path);
+    TSDestroyContext(context);
+
+    const nlohmann::json report = {
+        {"library_version", GetVersionString()},
+        {"volume_shape", {options.size, options.size, options.size}},
+        {"warmup", options.warmup},
+        {"repeats", options.repeats},
+        {"scenarios", results},
+    };
+    if (options.output.empty()) {
+        std::cout << report.dump(2) << std::endl;
+    } else {
+        std::ofstream(options.output) << report.dump(2) << std::endl;
+    }
+    return all_ok ? 0 : 1;
+}
@@ -7,6 +7,7 @@
 #include <iomanip>
 #include <cstdint>
 #include <filesystem>
+#include <utility>
 
 // Helper function to check and print errors
 void checkError(const TSError* error) {
@@ -44,12 +45,16 @@ public:
     }
 };
 
-// Function to get file size in MB
+// Function to get the on-disk size of a dataset in MB. Zarr arrays are
+// directories, so this sums the files inside.
 double getFileSizeMB(const std::string& filename) {
     std::filesystem::path path(filename);
     if (!std::filesystem::exists(path)) return 0.0;
-    
-    auto bytes = std::filesystem::file_size(path);
+
+    uintmax_t bytes = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+        if (entry.is_regular_file()) bytes += entry.file_size();
+    }
     return static_cast<double>(bytes) / (1024 * 1024);
 }
 
@@ -158,7 +163,7 @@ int main() {
                               : config.compressor) + "_" +
                              std::to_string(config.compression_level) + ".zarr";
 
-        TSDataset* dataset = TSCreateZarrCompressed(
+        TSDataset* dataset = TSCreateZarrCompressedEx(
             context,
             filename.c_str(),
             TS_UINT16,
@@ -168,11 +173,11 @@ int main() {
             shard_size_mb,
             config.compressor,
             config.compression_level,
-            &error,
             config.blosc_subcode,    // Blosc-specific parameters
             config.blosc_blocksize,
             config.shuffle,
-            config.num_threads
+            config.num_threads,
+            &error
         );
         checkError(&error);
 
@@ -202,38 +207,47 @@ int main() {
         TSCloseDataset(dataset);
     }
 
-    // Print recommendations
+    // Measure which settings suit this data best
     std::cout << "\nCompression Recommendations:\n" << std::string(50, '-') << std::endl;
-    
-    std::cout << "1. For fastest write performance:\n"
-              << "   - Use Blosc-LZ4 with light compression\n"
-              << "   - Enable shuffle mode 1 (byte shuffle)\n"
-              << "   - Use 4-8 threads depending on CPU\n";
-    
-    std::cout << "\n2. For best compression ratio:\n"
-              << "   - Use Blosc-ZSTD with heavy compression\n"
-              << "   - Enable shuffle mode 2 (bit shuffle)\n"
-              << "   - Increase block size for better compression\n";
-    
-    std::cout << "\n3. For fastest read performance:\n"
-              << "   - Use Blosc-LZ4 with balanced compression\n"
-              << "   - Enable shuffle mode 1\n"
-              << "   - Match block size to common read patterns\n";
-    
-    std::cout << "\n4. For memory-constrained systems:\n"
-              << "   - Use ZSTD (without Blosc) for lower memory usage\n"
-              << "   - Reduce block size and number of threads\n"
-              << "   - Use lighter compression levels\n";
-
-    std::cout << "\n5. Blosc-specific tips:\n"
-              << "   - LZ4: Best for fast compression/decompression\n"
-              << "   - ZSTD: Best for high compression ratio\n"
-              << "   - BLOSCLZ: Good balance of speed and compression\n"
-              << "   - Shuffle improves compression of structured data\n"
-              << "   - Block size affects both speed and ratio\n";
+
+    const int64_t sample_shape[] = {32, 32, 32};  // One chunk of the test pattern
+    std::vector<uint16_t> sample(32 * 32 * 32);
+    for (size_t i = 0; i < sample.size(); ++i) {
+        sample[i] = static_cast<uint16_t>((i % 16) * 4096);
+    }
+
+    const std::pair<const char*, TSCompressionGoal> goals[] = {
+        {"Fastest write", TS_COMPRESSION_GOAL_WRITE_THROUGHPUT},
+        {"Best ratio", TS_COMPRESSION_GOAL_RATIO},
+        {"Fastest read", TS_COMPRESSION_GOAL_READ_THROUGHPUT},
+    };
+    for (const auto& goal : goals) {
+        TSCompressionConfig best;
+        TSRecommendCompression(context, sample.data(), TS_UINT16, sample_shape, rank,
+                               goal.second, &best, &error);
+        checkError(&error);
+        std::cout << std::left << std::setw(16) << goal.first << best.compressor
+                  << (best.blosc_cname[0] ? std::string("/") + best.blosc_cname : "")
+                  << " level " << best.level << ", shuffle " << best.blosc_shuffle
+                  << std::fixed << std::setprecision(2) << " (ratio " << best.ratio
+                  << ", write " << best.write_mbps << " MiB/s, read " << best.read_mbps
+                  << " MiB/s)" << std::endl;
+    }
+
+    // The recommendation can be used to create a dataset directly
+    TSCompressionConfig best;
+    TSRecommendCompression(context, sample.data(), TS_UINT16, sample_shape, rank,
+                           TS_COMPRESSION_GOAL_RATIO, &best, &error);
+    checkError(&error);
+    TSDataset* tuned = TSCreateZarrWithConfig(context, "compression_test_tuned.zarr", TS_UINT16,
+                                              volume_shape, rank, chunks, shard_size_mb, &best,
+                                              &error);
+    checkError(&error);
+    TSCloseDataset(tuned);
 
     // Cleanup
     TSDestroyContext(context);
+    std::filesystem::remove_all("compression_test_tuned.zarr");
 
     std::cout << "\nCompression example completed successfully!" << std::endl;
     return 0;
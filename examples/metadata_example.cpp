@@ -55,6 +55,10 @@ int main() {
     );
     checkError(&error);
 
+    // Stage all updates and write the attributes once
+    TSBeginMetadataBatch(dataset, &error);
+    checkError(&error);
+
     // Set basic metadata
     std::cout << "\nSetting basic metadata..." << std::endl;
     TSSetMetadata(dataset, "title", "Metadata Example Dataset", &error);
@@ -99,6 +103,9 @@ int main() {
     TSSetMetadata(dataset, "processing.date", getCurrentTimestamp().c_str(), &error);
     checkError(&error);
 
+    TSCommitMetadataBatch(dataset, &error);
+    checkError(&error);
+
     // Read back and verify metadata
     std::cout << "\nReading metadata...\n" << std::endl;
     char value[256];
@@ -152,9 +159,11 @@ int main() {
     std::cout << "Listing all metadata keys:" << std::endl;
     std::cout << std::string(50, '-') << std::endl;
     
-    char* keys[100];  // Assume maximum 100 metadata keys
     size_t num_keys = 0;
-    TSListMetadata(dataset, keys, &num_keys, &error);
+    TSListMetadata(dataset, nullptr, &num_keys, &error);  // Query the count
+    checkError(&error);
+    std::vector<char*> keys(num_keys);
+    TSListMetadata(dataset, keys.data(), &num_keys, &error);
     checkError(&error);
 
     for (size_t i = 0; i < num_keys; ++i) {
@@ -7,38 +7,453 @@
     #else
         #define TENSORSTORE_DLL_API __declspec(dllimport)
     #endif
+#elif defined(__GNUC__)
+    #define TENSORSTORE_DLL_API __attribute__((visibility("default")))
 #else
     #define TENSORSTORE_DLL_API
 #endif
 
-#include <cstdint>
+#include <stddef.h>
+#include <stdint.h>
 
+#ifdef __cplusplus
 extern "C" {
+#endif
 
 // Error handling
-struct TSError {
+typedef struct TSError {
     const char* message;
     int code;
-};
+} TSError;
 
 // Opaque handle types
 typedef struct TSContext TSContext;
 typedef struct TSDataset TSDataset;
+typedef struct TSFuture TSFuture;
+typedef struct TSStreamWriter TSStreamWriter;
+typedef struct TSChunkView TSChunkView;
 
 // Data types
 typedef enum {
     TS_UINT8,   // unsigned char
     TS_UINT16,  // unsigned short
-    TS_UINT32   // uint32_t
+    TS_UINT32,  // uint32_t
+    TS_UINT64,  // uint64_t
+    TS_INT8,    // int8_t
+    TS_INT16,   // int16_t
+    TS_INT32,   // int32_t
+    TS_INT64,   // int64_t
+    TS_FLOAT16, // IEEE 754 half precision
+    TS_FLOAT32, // float
+    TS_FLOAT64  // double
 } TSDataType;
 
+// Ownership of TSError messages, see TSSetErrorMode.
+typedef enum {
+    TS_ERROR_MODE_HEAP,
+    TS_ERROR_MODE_THREAD_LOCAL
+} TSErrorMode;
+
+// Downsampling method for TSBuildPyramid.
+typedef enum {
+    TS_DOWNSAMPLE_MEAN,   // Average of each 2x2x2 spatial block
+    TS_DOWNSAMPLE_MODE,   // Most frequent value, for label volumes
+    TS_DOWNSAMPLE_STRIDE  // First element of each block
+} TSDownsampleMethod;
+
+// Access mode for TSOpenZarr.
+typedef enum {
+    TS_OPEN_READ,       // Writes through the handle fail
+    TS_OPEN_READ_WRITE
+} TSOpenMode;
+
+// What TSRecommendCompression optimises for.
+typedef enum {
+    TS_COMPRESSION_GOAL_WRITE_THROUGHPUT,  // Fastest encoding
+    TS_COMPRESSION_GOAL_RATIO,             // Smallest chunks
+    TS_COMPRESSION_GOAL_READ_THROUGHPUT    // Fastest decoding
+} TSCompressionGoal;
+
+// Chunk codec settings, as chosen by TSRecommendCompression and accepted by
+// TSCreateZarrWithConfig. The measured fields describe the trial run and are
+// ignored when creating a dataset.
+typedef struct {
+    char compressor[16];   // "none", "zstd" or "blosc"
+    char blosc_cname[16];  // Blosc inner codec, empty for other compressors
+    int level;
+    int blosc_shuffle;     // 0 (none), 1 (byte) or 2 (bit)
+    int blosc_blocksize;   // 0 lets blosc choose
+    double ratio;          // Uncompressed / compressed size of the sample
+    double write_mbps;     // Encode throughput, MiB/s of uncompressed data
+    double read_mbps;      // Decode throughput, MiB/s of uncompressed data
+} TSCompressionConfig;
+
+// Region of a dataset paired with the C-order buffer that holds its data.
+typedef struct {
+    const int64_t* origin;
+    const int64_t* shape;
+    void* data;
+} TSRegion;
+
+// How blocking reads of uncompressed chunk files reach the disk.
+typedef enum {
+    TS_FILE_IO_DEFAULT,  // Memory-mapped chunk files
+    TS_FILE_IO_URING     // Batched io_uring reads (Linux only)
+} TSFileIOBackend;
+
+// Context resource limits. Zero or negative values keep tensorstore's
+// default for that resource.
+typedef struct {
+    int64_t cache_pool_bytes;    // Total bytes of decoded chunks kept cached
+    int data_copy_concurrency;   // Threads used for encode/decode and copies
+    int file_io_concurrency;     // Concurrent file operations
+    TSFileIOBackend file_io_backend;
+} TSContextOptions;
+
+// Completion callback for asynchronous operations. `code` is 0 on success,
+// otherwise the absl::StatusCode of the failure.
+typedef void (*TSFutureCallback)(void* user_data, int code);
+
 // Context management
+//
+// With TS_FILE_IO_URING, blocking reads of uncompressed zarr v2 datasets
+// submit all chunk files of a region to the calling thread's io_uring
+// instance at once, so one thread keeps deep queues on NVMe drives.
+// Compressed and sharded datasets, writes and asynchronous reads still use
+// tensorstore's file driver, limited by file_io_concurrency. Context creation
+// fails if io_uring is not available.
 TENSORSTORE_DLL_API TSContext* TSCreateContext();
+TENSORSTORE_DLL_API TSContext* TSCreateContextWithOptions(const TSContextOptions* options,
+                                                          TSError* error);
+// Creates a context from a tensorstore context JSON spec, e.g.
+// {"cache_pool": {"total_bytes_limit": 1000000000}}.
+TENSORSTORE_DLL_API TSContext* TSCreateContextFromJson(const char* json_spec, TSError* error);
 TENSORSTORE_DLL_API void TSDestroyContext(TSContext* context);
 
+// Writes a JSON snapshot of the context's runtime metrics into `json_buf`:
+// per-operation counts, failures, bytes and latency histograms, the number of
+// operations in flight, the number of chunks loaded by read-ahead
+// (TSSetPrefetch), and allocation and reuse counts of the context's
+// scratch buffer pool. "tensorstore" holds tensorstore's process-wide chunk
+// cache counters (hits, misses, evictions, chunks read and written) and file
+// I/O counters; it is null in builds with TENSORSTORE_DLL_TENSORSTORE_METRICS
+// turned off. Fails if the buffer cannot hold the NUL-terminated result.
+TENSORSTORE_DLL_API int TSGetMetrics(TSContext* context, char* json_buf, size_t buf_size,
+                                     TSError* error);
+
+// Dataset management
+//
+// With a positive `shard_size_mb` the array is written in zarr v3 format with
+// `chunks` grouped into shards of up to that size by the sharding_indexed
+// codec, so each shard is a single file. Otherwise a zarr v2 array with one
+// file per chunk is created. Blocking reads of uncompressed zarr v2 arrays
+// (here and from TSOpenZarr) copy directly from memory-mapped chunk files,
+// so reads of hot data run at page cache speed. Not available on Windows.
+TENSORSTORE_DLL_API TSDataset* TSCreateZarr(TSContext* context, const char* path,
+                                            TSDataType dtype, const int64_t* shape,
+                                            int rank, const int64_t* chunks,
+                                            int shard_size_mb, TSError* error);
+// `compressor` is "none", "zstd" or "blosc"; blosc uses lz4 with byte
+// shuffling and an automatic block size.
+TENSORSTORE_DLL_API TSDataset* TSCreateZarrCompressed(TSContext* context, const char* path,
+                                                      TSDataType dtype, const int64_t* shape,
+                                                      int rank, const int64_t* chunks,
+                                                      int shard_size_mb, const char* compressor,
+                                                      int compression_level, TSError* error);
+// Like TSCreateZarrCompressed, with the blosc settings spelled out. They are
+// ignored for other compressors. A null `blosc_cname` means lz4,
+// `blosc_blocksize` 0 picks the block size automatically, and `blosc_shuffle`
+// is 0 (none), 1 (byte) or 2 (bit). `blosc_num_threads` is accepted for
+// compatibility; compression runs on the context's data copy threads.
+TENSORSTORE_DLL_API TSDataset* TSCreateZarrCompressedEx(TSContext* context, const char* path,
+                                                        TSDataType dtype, const int64_t* shape,
+                                                        int rank, const int64_t* chunks,
+                                                        int shard_size_mb,
+                                                        const char* compressor,
+                                                        int compression_level,
+                                                        const char* blosc_cname,
+                                                        int blosc_blocksize, int blosc_shuffle,
+                                                        int blosc_num_threads, TSError* error);
+TENSORSTORE_DLL_API TSDataset* TSCreateZarrWithConfig(TSContext* context, const char* path,
+                                                      TSDataType dtype, const int64_t* shape,
+                                                      int rank, const int64_t* chunks,
+                                                      int shard_size_mb,
+                                                      const TSCompressionConfig* config,
+                                                      TSError* error);
+// Trial-compresses `sample`, a C-order buffer of `dtype` elements with the
+// given shape, with a fixed set of zstd and blosc settings and returns the
+// one that best meets `goal` in `config`. The sample should be about one
+// chunk of representative data; it is compressed as a single chunk. Trials
+// run one at a time in memory on the context's data copy threads. For the
+// throughput goals, settings that barely compress the sample are skipped,
+// and "none" is returned if nothing compresses it.
+TENSORSTORE_DLL_API int TSRecommendCompression(TSContext* context, const void* sample,
+                                               TSDataType dtype, const int64_t* shape, int rank,
+                                               TSCompressionGoal goal,
+                                               TSCompressionConfig* config, TSError* error);
+// Opens an existing zarr v2 or v3 array. The opened array is cached in the
+// context by path and mode, so opening the same dataset again (from any
+// thread) returns a new handle without re-reading its metadata. Creating a
+// dataset with TSCreateZarr replaces the cached entry for its path. Each
+// returned handle must be closed with TSCloseDataset.
+TENSORSTORE_DLL_API TSDataset* TSOpenZarr(TSContext* context, const char* path,
+                                          TSOpenMode mode, TSError* error);
+TENSORSTORE_DLL_API void TSCloseDataset(TSDataset* dataset);
+
+// Dataset properties
+TENSORSTORE_DLL_API int TSGetShape(TSDataset* dataset, int64_t* shape, int* rank,
+                                   TSError* error);
+TENSORSTORE_DLL_API int TSGetChunkShape(TSDataset* dataset, int64_t* chunks, int* rank,
+                                        TSError* error);
+TENSORSTORE_DLL_API int TSGetDataType(TSDataset* dataset, TSDataType* dtype,
+                                      TSError* error);
+// Size in bytes of one element of `dtype`, or 0 for unknown values.
+TENSORSTORE_DLL_API size_t TSGetDataTypeSize(TSDataType dtype);
+
+// Blocking I/O
+TENSORSTORE_DLL_API int TSReadUInt16(TSDataset* dataset, const int64_t* origin,
+                                     const int64_t* shape, uint16_t* data,
+                                     TSError* error);
+TENSORSTORE_DLL_API int TSWriteUInt16(TSDataset* dataset, const int64_t* origin,
+                                      const int64_t* shape, const uint16_t* data,
+                                      TSError* error);
+
+// Typed I/O for any data type. `dtype` must match the dataset's data type.
+//
+// Writes of 16 MiB or more (here, through TSWriteAsync and TSWriteStrided)
+// are split into independent writes of one write chunk slab along the first
+// dimension each, so they are not atomic: when one slab fails, the others may
+// still have been stored. The call or future completes once every slab has
+// finished and reports the first error.
+TENSORSTORE_DLL_API int TSRead(TSDataset* dataset, const int64_t* origin,
+                               const int64_t* shape, TSDataType dtype, void* data,
+                               TSError* error);
+TENSORSTORE_DLL_API int TSWrite(TSDataset* dataset, const int64_t* origin,
+                                const int64_t* shape, TSDataType dtype, const void* data,
+                                TSError* error);
+
+// Reads into a C-order buffer of `dtype`, converting from the stored type
+// while copying out of the decoded chunks. For float32 and float64
+// destinations each value is also mapped to `value * scale + offset` after the
+// read, one chunk-sized block of the buffer at a time; pass 1 and 0 to skip
+// that step.
+// Conversions follow C++ static_cast semantics.
+TENSORSTORE_DLL_API int TSReadConvert(TSDataset* dataset, const int64_t* origin,
+                                      const int64_t* shape, TSDataType dtype, void* data,
+                                      double scale, double offset, TSError* error);
+
+// Metadata
+//
+// User attributes are stored in .zattrs for zarr v2 arrays and in the
+// "attributes" member of zarr.json for zarr v3 arrays. Each update outside a
+// batch is one read-modify-write of that file. Reads are served from a parsed
+// copy kept on the dataset handle.
+//
+// For zarr v3 the attributes are patched into zarr.json outside tensorstore,
+// so array handles opened before an update, here or in other processes, keep
+// the old array metadata. This library never rewrites the array metadata of
+// an open array, but tensorstore clients that do (e.g. a resize) must reopen
+// the array after attributes change, or they write the old attributes back.
+TENSORSTORE_DLL_API int TSSetMetadata(TSDataset* dataset, const char* key, const char* value,
+                                      TSError* error);
+// Merges every member of a JSON object into the attributes in one update.
+TENSORSTORE_DLL_API int TSSetMetadataJSON(TSDataset* dataset, const char* json,
+                                          TSError* error);
+// Between these calls, TSSetMetadata and TSSetMetadataJSON only stage their
+// updates (visible to TSGetMetadata/TSListMetadata on this handle); the commit
+// writes them all with a single read-modify-write.
+TENSORSTORE_DLL_API int TSBeginMetadataBatch(TSDataset* dataset, TSError* error);
+TENSORSTORE_DLL_API int TSCommitMetadataBatch(TSDataset* dataset, TSError* error);
+// String values are returned as-is, other JSON values serialized.
+TENSORSTORE_DLL_API int TSGetMetadata(TSDataset* dataset, const char* key, char* value,
+                                      size_t value_size, TSError* error);
+// Fills `keys` with pointers to the attribute names, owned by the dataset and
+// valid until the next TSListMetadata call or TSCloseDataset. On input
+// `*num_keys` is the capacity of `keys`; on output it is the number of keys,
+// and the call fails if that exceeds the capacity. With null `keys` only the
+// number of keys is stored in `*num_keys`.
+TENSORSTORE_DLL_API int TSListMetadata(TSDataset* dataset, char** keys, size_t* num_keys,
+                                       TSError* error);
+// By default the cached copy is trusted once loaded, so TSGetMetadata and
+// TSListMetadata do no I/O; updates through this handle are always seen.
+// Pass 1 to make every call stat the attributes file and reload the copy if
+// its mtime or size changed, which picks up updates made through other
+// handles or processes.
+TENSORSTORE_DLL_API int TSSetMetadataCheckMtime(TSDataset* dataset, int enabled,
+                                                TSError* error);
+
+// Multiscale pyramid
+//
+// Writes `levels` downsampled copies of the dataset as OME-Zarr multiscale
+// levels next to it, each half the size of the previous one in the spatial
+// dimensions. A base array at "image.zarr/0" gets levels "image.zarr/1",
+// "image.zarr/2", ...; other base names get a "_<level>" suffix. The base
+// must be inside a directory, which becomes the image group: the
+// multiscales description is written to its attributes. A bare relative
+// name such as "volume.zarr" is rejected. The levels reuse the base array's
+// chunking and codecs. Work proceeds one output chunk at a time with a
+// bounded number of chunks in flight, so memory use does not depend on the
+// volume size. Writes staged in the write-back cache are flushed first.
+//
+// TSBuildPyramid takes the trailing (up to three) dimensions as (z, y, x) and
+// up to two leading ones as (c) or (t, c). TSBuildPyramidWithAxes takes one
+// letter per dimension from "tczyx" instead, e.g. "tyx"; only z, y and x are
+// downsampled.
+TENSORSTORE_DLL_API int TSBuildPyramid(TSDataset* dataset, int levels,
+                                       TSDownsampleMethod method, TSError* error);
+TENSORSTORE_DLL_API int TSBuildPyramidWithAxes(TSDataset* dataset, int levels,
+                                               TSDownsampleMethod method, const char* axes,
+                                               TSError* error);
+
+// Read-ahead
+//
+// Enables prefetching for blocking TSRead/TSReadUInt16 calls that step
+// through the dataset in order along `dimension`: whenever a read starts
+// exactly where the previous one ended (same extent in all other
+// dimensions), the next `num_chunks` chunks are loaded in the background by
+// reading one element of each, which decodes the whole chunk into the cache.
+// Prefetched chunks are kept in the context's cache pool, so the context
+// needs a non-zero cache_pool_bytes for this to have any effect. Pass 0 to
+// disable. Must not be called concurrently with reads of the same dataset.
+TENSORSTORE_DLL_API int TSSetPrefetch(TSDataset* dataset, int dimension, int num_chunks,
+                                      TSError* error);
+
+// Write-back cache
+//
+// Buffers writes of the dataset in memory, up to `budget_bytes` of decoded
+// chunks. Partial writes that hit the same chunk are merged in memory, so
+// each dirty chunk is encoded and written to storage once, when the budget
+// is exceeded, on TSFlush, or when the dataset is closed. Reads through this
+// handle see the buffered data; other handles and TSStreamWriter do not until
+// it is flushed. A write call returns once its data has been copied, so
+// storage errors surface from the write that triggers a flush or from
+// TSFlush. TSCloseDataset flushes but cannot report errors; call TSFlush
+// first. While a flush is in progress, writes keep staging into a new
+// buffer, and reads through this handle wait for the flush to finish. Pass 0
+// to flush and disable. TSSetWriteBackCache must not be called concurrently
+// with other calls on the same dataset.
+TENSORSTORE_DLL_API int TSSetWriteBackCache(TSDataset* dataset, int64_t budget_bytes,
+                                            TSError* error);
+TENSORSTORE_DLL_API int TSFlush(TSDataset* dataset, TSError* error);
+
+// Direct writes
+//
+// Makes writes of whole write chunks (shards for sharded datasets; chunks
+// clipped at the upper bounds count as whole) bypass the page cache: the
+// data is encoded in memory and each chunk or shard file is written with
+// O_DIRECT from a pool of aligned buffers, then renamed into place. Other
+// writes, writes staged by TSSetWriteBackCache and TSStreamWriter are not
+// affected. Direct writes run on a few background threads per dataset, one
+// slab of write chunks along the first dimension at a time per thread;
+// TSWriteAsync returns once the write is queued. The files are replaced
+// without tensorstore's locking, so a direct write must not overlap any other
+// write of the same chunks, direct or not: wait for earlier TSWriteAsync
+// futures before writing chunks they touch. Disabling or closing the
+// dataset finishes queued direct writes. Linux only. Pass 0 to disable.
+TENSORSTORE_DLL_API int TSSetDirectWrite(TSDataset* dataset, int enable, TSError* error);
+
+// Strided I/O
+//
+// Like the blocking calls above, but for buffers of the dataset's element
+// type laid out with arbitrary `byte_strides` (one entry per dimension), e.g.
+// Fortran order or a padded row pitch. Passing null strides means C order.
+TENSORSTORE_DLL_API int TSReadStrided(TSDataset* dataset, const int64_t* origin,
+                                      const int64_t* shape, void* data,
+                                      const int64_t* byte_strides, TSError* error);
+TENSORSTORE_DLL_API int TSWriteStrided(TSDataset* dataset, const int64_t* origin,
+                                       const int64_t* shape, const void* data,
+                                       const int64_t* byte_strides, TSError* error);
+
+// Reads several regions in one call. Chunks shared between regions are
+// fetched and decoded once. Buffers use the dataset's element type. Returns
+// 0 if every region was read; otherwise reports the first failing region.
+TENSORSTORE_DLL_API int TSReadBatch(TSDataset* dataset, const TSRegion* regions,
+                                    size_t count, TSError* error);
+
+// Chunk views
+//
+// The region must cover exactly one chunk (clipped at the dataset bounds).
+// On success `data` points to read-only chunk data of the dataset's element
+// type laid out with `byte_strides` (one entry per dimension). The view is
+// zero-copy only for stored chunks of uncompressed datasets without a
+// write-back cache, where the mapped chunk file (or the bytes read from the
+// kvstore) is lent directly. Compressed, sharded, missing and staged chunks
+// are decoded into a buffer from the context's scratch pool, which is reused
+// once the view is released. The pointer stays valid until the view is
+// released.
+TENSORSTORE_DLL_API TSChunkView* TSReadChunkView(TSDataset* dataset, const int64_t* origin,
+                                                 const int64_t* shape, const void** data,
+                                                 int64_t* byte_strides, TSError* error);
+// Returns 1 if `view` lends the stored chunk bytes, 0 if they were copied.
+TENSORSTORE_DLL_API int TSChunkViewIsZeroCopy(const TSChunkView* view);
+TENSORSTORE_DLL_API void TSReleaseChunkView(TSChunkView* view);
+
+// Asynchronous I/O
+//
+// `data` is a C-order buffer of the dataset's element type and must stay
+// valid until the returned future is ready. Destroying a future that is
+// still pending does not cancel the operation.
+TENSORSTORE_DLL_API TSFuture* TSReadAsync(TSDataset* dataset, const int64_t* origin,
+                                          const int64_t* shape, void* data,
+                                          TSError* error);
+TENSORSTORE_DLL_API TSFuture* TSWriteAsync(TSDataset* dataset, const int64_t* origin,
+                                           const int64_t* shape, const void* data,
+                                           TSError* error);
+
+// Returns 1 if the operation has completed (successfully or not), 0 otherwise.
+TENSORSTORE_DLL_API int TSFutureIsReady(TSFuture* future);
+// Waits up to `timeout_ms` milliseconds (forever if negative). Returns 0 on
+// success, 1 on timeout and -1 if the operation failed.
+TENSORSTORE_DLL_API int TSFutureWait(TSFuture* future, int64_t timeout_ms,
+                                     TSError* error);
+// Invokes `callback` once the operation completes, immediately if it
+// already has. The callback may run on a tensorstore worker thread.
+TENSORSTORE_DLL_API int TSFutureSetCallback(TSFuture* future, TSFutureCallback callback,
+                                            void* user_data, TSError* error);
+TENSORSTORE_DLL_API void TSDestroyFuture(TSFuture* future);
+
+// Streaming frame writer
+//
+// Appends frames along the outermost dimension, starting at `start_frame`.
+// Each frame is a C-order buffer covering the full extent of the remaining
+// dimensions. Frames are gathered into slabs one write chunk deep and each
+// complete slab is written in the background; at most `max_pending_chunks`
+// slabs (2 if <= 0) are buffered or in flight, after which TSStreamWriterAppend
+// blocks. A writer must only be used from one thread at a time.
+TENSORSTORE_DLL_API TSStreamWriter* TSCreateStreamWriter(TSDataset* dataset,
+                                                         int64_t start_frame,
+                                                         int max_pending_chunks,
+                                                         TSError* error);
+TENSORSTORE_DLL_API int TSStreamWriterAppend(TSStreamWriter* writer, const void* frame,
+                                             TSError* error);
+// Writes any partially filled slab and waits for all pending writes.
+TENSORSTORE_DLL_API int TSStreamWriterFlush(TSStreamWriter* writer, TSError* error);
+TENSORSTORE_DLL_API int64_t TSStreamWriterGetFrameCount(TSStreamWriter* writer);
+// Flushes and releases the writer. The return value reports the final flush.
+TENSORSTORE_DLL_API int TSDestroyStreamWriter(TSStreamWriter* writer, TSError* error);
+
 // Error handling
+//
+// In the default TS_ERROR_MODE_HEAP every failure stores a heap-allocated
+// message that TSClearError frees. In TS_ERROR_MODE_THREAD_LOCAL the message
+// instead points into a fixed-size buffer owned by the failing thread: the
+// error path does not allocate, but the message is only valid on that thread
+// until its next failure, and long messages are truncated. The code is the
+// same in both modes. The mode can be switched at any time, and TSClearError
+// may be called from any thread, as long as a thread-local message is
+// cleared before its thread exits. Regions outside the dataset's domain are
+// rejected before any allocation, so out-of-bounds reads and writes fail
+// without allocating in TS_ERROR_MODE_THREAD_LOCAL; their message is only
+// formatted when TSErrorMessage is called, and until then holds just the
+// code name.
+TENSORSTORE_DLL_API void TSSetErrorMode(TSErrorMode mode);
+// Full message of `error`, or null if there is none. Call it on the thread
+// that failed.
+TENSORSTORE_DLL_API const char* TSErrorMessage(const TSError* error);
 TENSORSTORE_DLL_API void TSClearError(TSError* error);
 
+#ifdef __cplusplus
 } // extern "C"
+#endif
 
 #endif // TENSORSTORE_DLL_H_
@@ -16,6 +16,8 @@
     #else
         #define TENSORSTORE_DLL_API __declspec(dllimport)
     #endif
+#elif defined(__GNUC__)
+    #define TENSORSTORE_DLL_API __attribute__((visibility("default")))
 #else
     #define TENSORSTORE_DLL_API
 #endif
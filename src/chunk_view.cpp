@@ -0,0 +1,160 @@
+#include "handles.h"
+#include "error_handling.h"
+
+#include "tensorstore/array.h"
+#include "tensorstore/chunk_layout.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/util/endian.h"
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+struct TSChunkView {
+    std::shared_ptr<const MappedFile> mapped;     // Mapped chunk file, lent as-is
+    absl::Cord raw;                               // Stored chunk bytes, lent as-is
+    tensorstore::SharedArray<const void> decoded; // Decoded into a scratch buffer otherwise
+    bool zero_copy = false;                       // Data is the stored bytes, not a copy
+};
+
+namespace {
+
+// Zarr v2 key of the chunk with the given grid position ("i.j.k").
+std::string ChunkKey(const std::vector<tensorstore::Index>& grid_position) {
+    return absl::StrJoin(grid_position, ".");
+}
+
+void ComputeCOrderStrides(const std::vector<tensorstore::Index>& shape, tensorstore::Index element_size,
+                          int64_t* byte_strides) {
+    tensorstore::Index stride = element_size;
+    for (size_t i = shape.size(); i-- > 0;) {
+        byte_strides[i] = stride;
+        stride *= shape[i];
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+TSChunkView* TSReadChunkView(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                             const void** data, int64_t* byte_strides, TSError* error) {
+    if (!dataset || !origin || !shape || !data || !byte_strides) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return nullptr;
+    }
+    try {
+        auto layout = dataset->store.chunk_layout();
+        if (!layout.ok()) {
+            SetError(error, layout.status());
+            return nullptr;
+        }
+        auto domain = dataset->store.domain();
+        auto chunk_shape = layout->read_chunk_shape();
+        const tensorstore::DimensionIndex rank = dataset->store.rank();
+
+        // The region must be exactly one chunk, clipped at the upper bound.
+        std::vector<tensorstore::Index> grid_position(rank);
+        std::vector<tensorstore::Index> full_chunk(chunk_shape.begin(), chunk_shape.end());
+        for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+            const tensorstore::Index extent =
+                std::min(chunk_shape[i], domain[i].exclusive_max() - origin[i]);
+            if (chunk_shape[i] <= 0 || origin[i] % chunk_shape[i] != 0 || shape[i] != extent) {
+                SetError(error, absl::InvalidArgumentError(absl::StrCat(
+                                    "Region is not aligned to a single chunk in dimension ", i)));
+                return nullptr;
+            }
+            grid_position[i] = origin[i] / chunk_shape[i];
+        }
+
+        const tensorstore::DataType dtype = ToTensorstoreDataType(dataset->dtype);
+        auto view = std::make_unique<TSChunkView>();
+
+        // Uncompressed little-endian chunks are already in their decoded
+        // layout on disk. Lend the mapped file, or where files cannot be
+        // mapped, the bytes straight from the kvstore read.
+        // Zarr v2 stores edge chunks at full size, so the strides are those
+        // of a full chunk.
+        if (dataset->mapped_chunks && !dataset->write_back) {
+            auto file = MapChunk(dataset->mapped_chunks.get(), grid_position);
+            if (!file.ok()) {
+                SetError(error, file.status());
+                return nullptr;
+            }
+            if (*file) {
+                view->mapped = *std::move(file);
+                view->zero_copy = true;
+                *data = view->mapped->data();
+                ComputeCOrderStrides(full_chunk, dtype.size(), byte_strides);
+                return view.release();
+            }
+        } else if (dataset->raw_chunks && !dataset->write_back &&
+                   tensorstore::endian::native == tensorstore::endian::little) {
+            auto read = tensorstore::kvstore::Read(dataset->kvstore, ChunkKey(grid_position)).result();
+            if (!read.ok()) {
+                SetError(error, read.status());
+                return nullptr;
+            }
+            tensorstore::Index num_bytes = dtype.size();
+            for (tensorstore::Index extent : full_chunk) num_bytes *= extent;
+            if (read->has_value() && static_cast<tensorstore::Index>(read->value.size()) == num_bytes) {
+                view->raw = std::move(read->value);
+                // A fragmented cord is copied into one block by Flatten.
+                view->zero_copy = view->raw.TryFlat().has_value();
+                *data = view->raw.Flatten().data();
+                ComputeCOrderStrides(full_chunk, dtype.size(), byte_strides);
+                return view.release();
+            }
+            // Missing chunks resolve to the fill value through the regular path.
+        }
+
+        // Other chunks are decoded into a scratch buffer that returns to the
+        // context's pool when the view is released, so a reader cycling
+        // through views reuses the same memory.
+        size_t bytes = dtype.size();
+        for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+            bytes *= static_cast<size_t>(shape[i]);
+        }
+        tensorstore::SharedArray<void> array(
+            tensorstore::SharedElementPointer<void>(dataset->scratch->AcquireShared(bytes), dtype),
+            tensorstore::StridedLayout<>(tensorstore::c_order, dtype.size(),
+                                         tensorstore::span<const tensorstore::Index>(shape, rank)));
+        auto status =
+            ReadWithWriteBack(dataset,
+                              [&](const tensorstore::Transaction& transaction)
+                                  -> tensorstore::Future<void> {
+                                  auto region = GetRegion(dataset, origin, shape, transaction);
+                                  if (!region.ok()) {
+                                      return tensorstore::MakeReadyFuture<void>(region.status());
+                                  }
+                                  return tensorstore::Read(*region, array);
+                              })
+                .status();
+        if (!status.ok()) {
+            SetError(error, status);
+            return nullptr;
+        }
+        view->decoded = std::move(array);
+        *data = view->decoded.data();
+        ComputeCOrderStrides(std::vector<tensorstore::Index>(shape, shape + rank), dtype.size(),
+                             byte_strides);
+        return view.release();
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return nullptr;
+    }
+}
+
+int TSChunkViewIsZeroCopy(const TSChunkView* view) {
+    return view && view->zero_copy ? 1 : 0;
+}
+
+void TSReleaseChunkView(TSChunkView* view) {
+    delete view;
+}
+
+} // extern "C"
@@ -0,0 +1,248 @@
+#include "tensorstore_dll/span_fix.h"  // Must come first
+#include "tensorstore_dll/tensorstore_dll.h"
+#include "error_handling.h"
+#include "handles.h"
+#include "zarr_spec.h"
+
+#include "tensorstore/array.h"
+#include "tensorstore/context.h"
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/open.h"
+#include "tensorstore/tensorstore.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Codec settings tried by TSRecommendCompression, from fastest to densest
+// within each family.
+struct Candidate {
+    const char* compressor;
+    const char* blosc_cname;
+    int level;
+    int blosc_shuffle;
+};
+
+const Candidate kCandidates[] = {
+    {"zstd", "", 1, 0},
+    {"zstd", "", 3, 0},
+    {"zstd", "", 9, 0},
+    {"blosc", "lz4", 5, 1},
+    {"blosc", "lz4", 5, 2},
+    {"blosc", "lz4hc", 9, 2},
+    {"blosc", "blosclz", 5, 1},
+    {"blosc", "zstd", 3, 1},
+    {"blosc", "zstd", 9, 2},
+};
+
+// Candidates that shrink the sample by less than this are not worth the
+// codec time for the throughput goals.
+constexpr double kMinUsefulRatio = 1.05;
+
+// Reads are repeated and the fastest kept, to reduce timer noise on small
+// samples.
+constexpr int kReadRepeats = 2;
+
+double MegabytesPerSecond(int64_t bytes, Clock::duration elapsed) {
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? bytes / seconds / (1 << 20) : 0.0;
+}
+
+void CopyName(char* dest, size_t size, const std::string& name) {
+    const size_t n = std::min(size - 1, name.size());
+    std::memcpy(dest, name.data(), n);
+    dest[n] = '\0';
+}
+
+// Starts opening an in-memory zarr array with the candidate's codec that
+// holds the sample as a single chunk.
+tensorstore::Result<tensorstore::Future<tensorstore::TensorStore<>>> OpenTrial(
+    const tensorstore::Context& context, const Candidate& candidate, int index,
+    const tensorstore::SharedArray<const void>& sample, TSDataType dtype) {
+    CompressionOptions compression;
+    compression.compressor = candidate.compressor;
+    compression.level = candidate.level;
+    if (*candidate.blosc_cname) compression.blosc_cname = candidate.blosc_cname;
+    compression.blosc_shuffle = candidate.blosc_shuffle;
+
+    const std::string prefix = absl::StrCat("trial", index, "/");
+    const int rank = static_cast<int>(sample.rank());
+    const std::vector<int64_t> shape(sample.shape().begin(), sample.shape().end());
+    auto spec = BuildZarrSpec({{"driver", "memory"}, {"path", prefix}}, dtype, shape.data(),
+                              rank, shape.data(), 0, compression);
+    if (!spec.ok()) {
+        return spec.status();
+    }
+    return tensorstore::Open(*spec, context, tensorstore::OpenMode::create,
+                             tensorstore::ReadWriteMode::read_write);
+}
+
+// Writes the sample into the trial's store and measures encode and decode
+// throughput and the size of the stored chunk.
+tensorstore::Result<TSCompressionConfig> RunTrial(const Candidate& candidate,
+                                                  const tensorstore::TensorStore<>& store,
+                                                  const tensorstore::SharedArray<const void>& sample) {
+    const int rank = static_cast<int>(sample.rank());
+    const int64_t bytes = sample.num_elements() * sample.dtype().size();
+    auto start = Clock::now();
+    auto status = tensorstore::Write(sample, store).commit_future.status();
+    if (!status.ok()) {
+        return status;
+    }
+    const auto write_time = Clock::now() - start;
+
+    // The trial context has no cache pool, so every read decodes the chunk.
+    Clock::duration read_time = Clock::duration::max();
+    for (int i = 0; i < kReadRepeats; ++i) {
+        start = Clock::now();
+        auto data = tensorstore::Read(store).result();
+        if (!data.ok()) {
+            return data.status();
+        }
+        read_time = std::min(read_time, Clock::now() - start);
+    }
+
+    const std::string chunk_key = absl::StrJoin(std::vector<std::string>(rank, "0"), ".");
+    auto chunk = tensorstore::kvstore::Read(store.kvstore(), chunk_key).result();
+    if (!chunk.ok()) {
+        return chunk.status();
+    }
+    if (!chunk->has_value() || chunk->value.empty()) {
+        return absl::InternalError(absl::StrCat("Trial chunk ", chunk_key, " was not written"));
+    }
+
+    TSCompressionConfig config = {};
+    CopyName(config.compressor, sizeof(config.compressor), candidate.compressor);
+    CopyName(config.blosc_cname, sizeof(config.blosc_cname), candidate.blosc_cname);
+    config.level = candidate.level;
+    config.blosc_shuffle = candidate.blosc_shuffle;
+    config.blosc_blocksize = 0;
+    config.ratio = static_cast<double>(bytes) / static_cast<double>(chunk->value.size());
+    config.write_mbps = MegabytesPerSecond(bytes, write_time);
+    config.read_mbps = MegabytesPerSecond(bytes, read_time);
+    return config;
+}
+
+double Score(const TSCompressionConfig& config, TSCompressionGoal goal) {
+    switch (goal) {
+        case TS_COMPRESSION_GOAL_RATIO:
+            return config.ratio;
+        case TS_COMPRESSION_GOAL_WRITE_THROUGHPUT:
+            return config.write_mbps;
+        case TS_COMPRESSION_GOAL_READ_THROUGHPUT:
+            return config.read_mbps;
+    }
+    return 0.0;
+}
+
+} // namespace
+
+extern "C" {
+
+int TSRecommendCompression(TSContext* context, const void* sample, TSDataType dtype,
+                           const int64_t* shape, int rank, TSCompressionGoal goal,
+                           TSCompressionConfig* config, TSError* error) {
+    if (!context || !sample || !shape || rank <= 0 || !config ||
+        (goal != TS_COMPRESSION_GOAL_WRITE_THROUGHPUT && goal != TS_COMPRESSION_GOAL_RATIO &&
+         goal != TS_COMPRESSION_GOAL_READ_THROUGHPUT)) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    const tensorstore::DataType ts_dtype = ToTensorstoreDataType(dtype);
+    if (!ts_dtype.valid()) {
+        SetError(error, absl::InvalidArgumentError("Invalid data type"));
+        return -1;
+    }
+    for (int i = 0; i < rank; ++i) {
+        if (shape[i] <= 0) {
+            SetError(error, absl::InvalidArgumentError("Sample shape must not be empty"));
+            return -1;
+        }
+    }
+    try {
+        // Trials share the context's data copy threads but get their own
+        // in-memory store and no chunk cache, so nothing outlives this call
+        // and reads measure decoding rather than cache hits.
+        auto trial_spec = tensorstore::Context::Spec::FromJson({
+            {"memory_key_value_store", ::nlohmann::json::object()},
+            {"cache_pool", ::nlohmann::json::object()},
+        });
+        if (!trial_spec.ok()) {
+            SetError(error, trial_spec.status());
+            return -1;
+        }
+        const tensorstore::Context trial_context(*trial_spec, context->ctx);
+
+        auto pointer = tensorstore::UnownedToShared(
+            tensorstore::ElementPointer<const void>(sample, ts_dtype));
+        const tensorstore::SharedArray<const void> array(
+            pointer, tensorstore::StridedLayout<>(tensorstore::c_order, ts_dtype.size(),
+                                                  tensorstore::span<const tensorstore::Index>(
+                                                      shape, rank)));
+
+        // Stores are opened concurrently, but trials are timed one at a time
+        // so they do not compete for cores and memory bandwidth.
+        constexpr size_t kNumCandidates = std::size(kCandidates);
+        std::vector<tensorstore::Future<tensorstore::TensorStore<>>> stores;
+        stores.reserve(kNumCandidates);
+        for (size_t i = 0; i < kNumCandidates; ++i) {
+            auto store = OpenTrial(trial_context, kCandidates[i], static_cast<int>(i), array,
+                                   dtype);
+            if (!store.ok()) {
+                SetError(error, store.status());
+                return -1;
+            }
+            stores.push_back(*std::move(store));
+        }
+        std::vector<tensorstore::Result<TSCompressionConfig>> results;
+        results.reserve(kNumCandidates);
+        for (size_t i = 0; i < kNumCandidates; ++i) {
+            auto store = stores[i].result();
+            if (!store.ok()) {
+                SetError(error, store.status());
+                return -1;
+            }
+            results.push_back(RunTrial(kCandidates[i], *store, array));
+        }
+
+        const TSCompressionConfig* best = nullptr;
+        for (const auto& result : results) {
+            if (!result.ok()) {
+                SetError(error, result.status());
+                return -1;
+            }
+            if (goal != TS_COMPRESSION_GOAL_RATIO && result->ratio < kMinUsefulRatio) {
+                continue;
+            }
+            if (!best || Score(*result, goal) > Score(*best, goal)) {
+                best = &*result;
+            }
+        }
+        if (best) {
+            *config = *best;
+        } else {
+            // Nothing compresses this data; storing it raw is fastest.
+            *config = TSCompressionConfig{};
+            CopyName(config->compressor, sizeof(config->compressor), "none");
+            config->ratio = 1.0;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+} // extern "C"
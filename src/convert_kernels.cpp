@@ -0,0 +1,13 @@
+#include "convert_kernels.h"
+
+void ScaleOffset(float* data, size_t count, float scale, float offset) {
+    for (size_t i = 0; i < count; ++i) {
+        data[i] = data[i] * scale + offset;
+    }
+}
+
+void ScaleOffset(double* data, size_t count, double scale, double offset) {
+    for (size_t i = 0; i < count; ++i) {
+        data[i] = data[i] * scale + offset;
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef TENSORSTORE_DLL_CONVERT_KERNELS_H_
+#define TENSORSTORE_DLL_CONVERT_KERNELS_H_
+
+#include <cstddef>
+
+// In-place `data[i] = data[i] * scale + offset` over a contiguous run. Plain
+// loops; the compiler vectorizes them.
+void ScaleOffset(float* data, size_t count, float scale, float offset);
+void ScaleOffset(double* data, size_t count, double scale, double offset);
+
+#endif // TENSORSTORE_DLL_CONVERT_KERNELS_H_
@@ -0,0 +1,65 @@
+#include "data_types.h"
+
+#include <cstdint>
+
+tensorstore::DataType ToTensorstoreDataType(TSDataType dtype) {
+    switch (dtype) {
+        case TS_UINT8:   return tensorstore::dtype_v<uint8_t>;
+        case TS_UINT16:  return tensorstore::dtype_v<uint16_t>;
+        case TS_UINT32:  return tensorstore::dtype_v<uint32_t>;
+        case TS_UINT64:  return tensorstore::dtype_v<uint64_t>;
+        case TS_INT8:    return tensorstore::dtype_v<int8_t>;
+        case TS_INT16:   return tensorstore::dtype_v<int16_t>;
+        case TS_INT32:   return tensorstore::dtype_v<int32_t>;
+        case TS_INT64:   return tensorstore::dtype_v<int64_t>;
+        case TS_FLOAT16: return tensorstore::dtype_v<tensorstore::dtypes::float16_t>;
+        case TS_FLOAT32: return tensorstore::dtype_v<tensorstore::dtypes::float32_t>;
+        case TS_FLOAT64: return tensorstore::dtype_v<tensorstore::dtypes::float64_t>;
+    }
+    return tensorstore::DataType();
+}
+
+bool FromTensorstoreDataType(tensorstore::DataType dtype, TSDataType* result) {
+    for (TSDataType candidate : {TS_UINT8, TS_UINT16, TS_UINT32, TS_UINT64, TS_INT8, TS_INT16,
+                                 TS_INT32, TS_INT64, TS_FLOAT16, TS_FLOAT32, TS_FLOAT64}) {
+        if (ToTensorstoreDataType(candidate) == dtype) {
+            *result = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* ToZarrDataType(TSDataType dtype) {
+    switch (dtype) {
+        case TS_UINT8:   return "|u1";
+        case TS_UINT16:  return "<u2";
+        case TS_UINT32:  return "<u4";
+        case TS_UINT64:  return "<u8";
+        case TS_INT8:    return "|i1";
+        case TS_INT16:   return "<i2";
+        case TS_INT32:   return "<i4";
+        case TS_INT64:   return "<i8";
+        case TS_FLOAT16: return "<f2";
+        case TS_FLOAT32: return "<f4";
+        case TS_FLOAT64: return "<f8";
+    }
+    return nullptr;
+}
+
+const char* ToZarr3DataType(TSDataType dtype) {
+    switch (dtype) {
+        case TS_UINT8:   return "uint8";
+        case TS_UINT16:  return "uint16";
+        case TS_UINT32:  return "uint32";
+        case TS_UINT64:  return "uint64";
+        case TS_INT8:    return "int8";
+        case TS_INT16:   return "int16";
+        case TS_INT32:   return "int32";
+        case TS_INT64:   return "int64";
+        case TS_FLOAT16: return "float16";
+        case TS_FLOAT32: return "float32";
+        case TS_FLOAT64: return "float64";
+    }
+    return nullptr;
+}
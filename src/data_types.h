@@ -0,0 +1,23 @@
+#ifndef TENSORSTORE_DLL_DATA_TYPES_H_
+#define TENSORSTORE_DLL_DATA_TYPES_H_
+
+#include "tensorstore_dll/span_fix.h"  // Must come first
+#include "tensorstore_dll/tensorstore_dll.h"
+
+#include "tensorstore/data_type.h"
+
+// Returns an invalid (null) DataType for values outside TSDataType.
+tensorstore::DataType ToTensorstoreDataType(TSDataType dtype);
+
+// Inverse of ToTensorstoreDataType. Returns false for data types without a
+// TSDataType equivalent.
+bool FromTensorstoreDataType(tensorstore::DataType dtype, TSDataType* result);
+
+// Zarr v2 dtype string (e.g. "<u2"), or nullptr for values outside TSDataType.
+const char* ToZarrDataType(TSDataType dtype);
+
+// Zarr v3 data_type name (e.g. "uint16"), or nullptr for values outside
+// TSDataType.
+const char* ToZarr3DataType(TSDataType dtype);
+
+#endif // TENSORSTORE_DLL_DATA_TYPES_H_
@@ -0,0 +1,64 @@
+#include "dataset_cache.h"
+
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+std::string DatasetCache::NormalizePath(const char* path) {
+    std::error_code ec;
+    std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+    if (ec) {
+        absolute = path;
+    }
+    std::string result = absolute.lexically_normal().generic_string();
+    while (result.size() > 1 && result.back() == '/') {
+        result.pop_back();
+    }
+    return result;
+}
+
+std::string DatasetCache::Key(const std::string& path, bool writable) {
+    return (writable ? "rw:" : "r:") + path;
+}
+
+std::optional<DatasetCacheEntry> DatasetCache::Find(const std::string& path,
+                                                    bool writable) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(Key(path, writable));
+    if (it == entries_.end()) {
+        return std::nullopt;
+    }
+    uses_.splice(uses_.begin(), uses_, it->second.use);
+    return it->second.entry;
+}
+
+void DatasetCache::Insert(const std::string& path, bool writable, DatasetCacheEntry entry) {
+    if (capacity_ == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = Key(path, writable);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        it->second.entry = std::move(entry);
+        uses_.splice(uses_.begin(), uses_, it->second.use);
+        return;
+    }
+    while (entries_.size() >= capacity_) {
+        entries_.erase(uses_.back());
+        uses_.pop_back();
+    }
+    uses_.push_front(key);
+    entries_.emplace(std::move(key), Slot{std::move(entry), uses_.begin()});
+}
+
+void DatasetCache::Erase(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (bool writable : {false, true}) {
+        auto it = entries_.find(Key(path, writable));
+        if (it != entries_.end()) {
+            uses_.erase(it->second.use);
+            entries_.erase(it);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef TENSORSTORE_DLL_DATASET_CACHE_H_
+#define TENSORSTORE_DLL_DATASET_CACHE_H_
+
+#include "tensorstore_dll/span_fix.h"  // Must come first
+#include "tensorstore_dll/tensorstore_dll.h"
+
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/tensorstore.h"
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Everything needed to hand out a new TSDataset for an already opened array.
+struct DatasetCacheEntry {
+    tensorstore::TensorStore<> store;
+    tensorstore::KvStore kvstore;
+    TSDataType dtype;
+    int zarr_format = 2;
+    bool raw_chunks = false;
+};
+
+// Per-context map from dataset path and open mode to the opened array, so
+// reopening a dataset copies a handle instead of re-reading its metadata.
+// Holds at most `capacity` arrays; the least recently used one is dropped
+// to make room, so a context opening many datasets does not keep them all.
+class DatasetCache {
+public:
+    static constexpr size_t kDefaultCapacity = 64;
+
+    explicit DatasetCache(size_t capacity = kDefaultCapacity) : capacity_(capacity) {}
+
+    // Normalized form of `path` used as the cache key.
+    static std::string NormalizePath(const char* path);
+
+    std::optional<DatasetCacheEntry> Find(const std::string& path, bool writable) const;
+    void Insert(const std::string& path, bool writable, DatasetCacheEntry entry);
+    // Drops both the read-only and read-write entries for `path`.
+    void Erase(const std::string& path);
+
+private:
+    static std::string Key(const std::string& path, bool writable);
+
+    struct Slot {
+        DatasetCacheEntry entry;
+        std::list<std::string>::iterator use;  // Position in `uses_`
+    };
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    mutable std::list<std::string> uses_;  // Keys, most recently used first
+    std::unordered_map<std::string, Slot> entries_;
+};
+
+#endif // TENSORSTORE_DLL_DATASET_CACHE_H_
@@ -0,0 +1,369 @@
+#include "handles.h"
+#include "direct_write.h"
+#include "error_handling.h"
+
+#include "tensorstore/chunk_layout.h"
+#include "tensorstore/context.h"
+#include "tensorstore/index_space/dim_expression.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/open.h"
+#include "tensorstore/util/executor.h"
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Keys of the staging array that describe it rather than hold chunk data.
+bool IsMetadataKey(const std::string& key) {
+    return key == ".zarray" || key == ".zattrs" || key == ".zgroup" || key == "zarr.json";
+}
+
+#ifdef __linux__
+
+absl::Status ErrnoError(const char* operation, const std::string& path) {
+    return absl::ErrnoToStatus(errno, absl::StrCat(operation, " ", path));
+}
+
+absl::Status WriteAll(int fd, const char* data, size_t size, const std::string& path) {
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return ErrnoError("Failed to write", path);
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return absl::OkStatus();
+}
+
+// Replaces the file at `path` with `contents`. The data is written with
+// O_DIRECT to a temporary file, padded to the alignment and truncated back,
+// which is then renamed over `path` the same way tensorstore's file driver
+// replaces chunks. File systems without O_DIRECT support (e.g. tmpfs) get a
+// buffered write whose pages are dropped once they reach the disk.
+absl::Status WriteFileDirect(const std::string& path, const absl::Cord& contents,
+                             ScratchPool& scratch) {
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    const std::string temp_path = absl::StrCat(path, ".__direct_write");
+    bool direct = true;
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+    if (fd < 0 && errno == EINVAL) {
+        direct = false;
+        fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) {
+        return ErrnoError("Failed to create", temp_path);
+    }
+
+    const size_t size = contents.size();
+    // Scratch buffers are page aligned and a whole number of pages long.
+    ScratchPool::Buffer buffer = scratch.Acquire(size);
+    char* out = buffer.data();
+    for (absl::string_view fragment : contents.Chunks()) {
+        std::memcpy(out, fragment.data(), fragment.size());
+        out += fragment.size();
+    }
+    const size_t padded =
+        direct ? (size + ScratchPool::kAlignment - 1) / ScratchPool::kAlignment *
+                     ScratchPool::kAlignment
+               : size;
+    std::memset(buffer.data() + size, 0, padded - size);
+
+    absl::Status status = WriteAll(fd, buffer.data(), padded, temp_path);
+    if (status.ok() && direct && ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        status = ErrnoError("Failed to truncate", temp_path);
+    }
+    if (status.ok() && !direct) {
+        if (::fdatasync(fd) != 0) {
+            status = ErrnoError("Failed to sync", temp_path);
+        } else {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+    }
+    ::close(fd);
+    if (status.ok() && std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        status = ErrnoError("Failed to rename", temp_path);
+    }
+    if (!status.ok()) {
+        std::remove(temp_path.c_str());
+    }
+    return status;
+}
+
+// Moves every chunk file the staging array produced to disk. All staged
+// files are removed from memory, even if a write fails.
+absl::Status FlushStaging(TSDataset* dataset, DirectStaging& staging) {
+    auto entries = tensorstore::kvstore::ListFuture(staging.kvstore).result();
+    if (!entries.ok()) {
+        return entries.status();
+    }
+    absl::Status status;
+    for (const auto& entry : *entries) {
+        if (IsMetadataKey(entry.key)) continue;
+        if (status.ok()) {
+            auto read = tensorstore::kvstore::Read(staging.kvstore, entry.key).result();
+            if (!read.ok()) {
+                status = read.status();
+            } else if (read->has_value()) {
+                status = WriteFileDirect(absl::StrCat(dataset->path, "/", entry.key),
+                                         read->value, *dataset->scratch);
+            }
+        }
+        tensorstore::kvstore::Delete(staging.kvstore, entry.key).status().IgnoreError();
+    }
+    return status;
+}
+
+#endif
+
+// Opens a copy of the dataset's array in a private memory kvstore. Chunks
+// equal to the fill value are stored too, so every written chunk replaces
+// its file on disk.
+absl::Status OpenStaging(TSDataset* dataset, DirectStaging* staging) {
+    auto spec = dataset->store.spec();
+    if (!spec.ok()) {
+        return spec.status();
+    }
+    auto json = spec->ToJson();
+    if (!json.ok()) {
+        return json.status();
+    }
+    ::nlohmann::json metadata = (*json)["metadata"];
+    metadata.erase("attributes");
+    const ::nlohmann::json staging_spec = {
+        {"driver", (*json)["driver"]},
+        {"kvstore", {{"driver", "memory"}}},
+        {"metadata", std::move(metadata)},
+        {"store_data_equal_to_fill_value", true},
+    };
+
+    auto context_spec = tensorstore::Context::Spec::FromJson({
+        {"memory_key_value_store", ::nlohmann::json::object()},
+        {"cache_pool", ::nlohmann::json::object()},
+    });
+    if (!context_spec.ok()) {
+        return context_spec.status();
+    }
+    const tensorstore::Context context(*context_spec, dataset->context);
+    auto store = tensorstore::Open(staging_spec, context, tensorstore::OpenMode::create,
+                                   tensorstore::ReadWriteMode::read_write)
+                     .result();
+    if (!store.ok()) {
+        return store.status();
+    }
+    staging->store = *std::move(store);
+    staging->kvstore = staging->store.kvstore();
+    return absl::OkStatus();
+}
+
+// Encodes one slab of whole write chunks into `staging` and writes the
+// resulting files.
+absl::Status WriteSlab(TSDataset* dataset, DirectStaging& staging,
+                       const std::vector<tensorstore::Index>& origin,
+                       const std::vector<tensorstore::Index>& shape,
+                       const tensorstore::SharedArray<const void>& slab) {
+#ifdef __linux__
+    auto region =
+        staging.store | tensorstore::AllDims().TranslateSizedInterval(origin, shape);
+    if (!region.ok()) {
+        return region.status();
+    }
+    auto status = tensorstore::Write(slab, *region).commit_future.status();
+    if (!status.ok()) {
+        return status;
+    }
+    return FlushStaging(dataset, staging);
+#else
+    (void)dataset;
+    (void)staging;
+    (void)origin;
+    (void)shape;
+    (void)slab;
+    return absl::UnimplementedError("Direct writes are only supported on Linux");
+#endif
+}
+
+// Each worker encodes into its own staging array, opened when it starts.
+void RunWorker(TSDataset* dataset, DirectWriter* writer) {
+    DirectStaging staging;
+    const absl::Status opened = OpenStaging(dataset, &staging);
+    std::unique_lock<std::mutex> lock(writer->mutex);
+    while (true) {
+        writer->queue_ready.wait(lock, [&] { return writer->stopping || !writer->queue.empty(); });
+        if (writer->queue.empty()) {
+            return;
+        }
+        DirectWriter::Job job = std::move(writer->queue.front());
+        writer->queue.pop_front();
+        lock.unlock();
+        absl::Status status = opened;
+        if (status.ok()) {
+            try {
+                status = job.run(staging);
+            } catch (const std::exception& e) {
+                status = absl::InternalError(e.what());
+            }
+        }
+        job.promise.SetResult(tensorstore::MakeResult(status));
+        lock.lock();
+    }
+}
+
+} // namespace
+
+DirectWriter::~DirectWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queue_ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+bool IsWholeWriteChunks(TSDataset* dataset, const int64_t* origin, const int64_t* shape) {
+    DirectWriter* writer = dataset->direct_write.get();
+    if (!writer) {
+        return false;
+    }
+    auto domain = dataset->store.domain();
+    for (size_t i = 0; i < writer->write_chunk_shape.size(); ++i) {
+        // Chunk boundaries are measured from the grid origin, not from zero.
+        const tensorstore::Index chunk = writer->write_chunk_shape[i];
+        const tensorstore::Index start = origin[i] - writer->grid_origin[i];
+        const tensorstore::Index end = origin[i] + shape[i];
+        if (shape[i] <= 0 || origin[i] < domain[i].inclusive_min() ||
+            end > domain[i].exclusive_max() || start % chunk != 0 ||
+            ((end - writer->grid_origin[i]) % chunk != 0 && end != domain[i].exclusive_max())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+tensorstore::Future<void> StartWriteDirect(TSDataset* dataset, const int64_t* origin,
+                                           const int64_t* shape,
+                                           tensorstore::SharedArray<const void> array) {
+    DirectWriter* writer = dataset->direct_write.get();
+    const size_t rank = writer->write_chunk_shape.size();
+    std::vector<tensorstore::Index> slab_origin(origin, origin + rank);
+    std::vector<tensorstore::Index> slab_shape(shape, shape + rank);
+    const tensorstore::Index depth = writer->write_chunk_shape[0];
+    const size_t max_workers = std::min<size_t>(
+        DirectWriter::kMaxWorkers, std::max(1u, std::thread::hardware_concurrency()));
+
+    // Each row of write chunks along dimension 0 is a job of its own, so
+    // memory use is bounded by a slab and the workers write slabs in parallel.
+    std::vector<tensorstore::AnyFuture> slabs;
+    {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        for (tensorstore::Index start = origin[0]; start < origin[0] + shape[0]; start += depth) {
+            slab_origin[0] = start;
+            slab_shape[0] = std::min(depth, origin[0] + shape[0] - start);
+            tensorstore::SharedArray<const void> slab(
+                tensorstore::AddByteOffset(array.element_pointer(),
+                                           (start - origin[0]) * array.byte_strides()[0]),
+                tensorstore::StridedLayout<>(slab_shape, array.byte_strides()));
+            auto pair = tensorstore::PromiseFuturePair<void>::Make();
+            writer->queue.push_back(DirectWriter::Job{
+                [dataset, slab_origin, slab_shape, slab = std::move(slab)](DirectStaging& staging) {
+                    return WriteSlab(dataset, staging, slab_origin, slab_shape, slab);
+                },
+                std::move(pair.promise)});
+            slabs.push_back(std::move(pair.future));
+        }
+        while (writer->workers.size() < std::min(max_workers, writer->queue.size())) {
+            writer->workers.emplace_back(RunWorker, dataset, writer);
+        }
+    }
+    writer->queue_ready.notify_all();
+
+    // The slabs all copy from the caller's buffer, so the combined future
+    // waits for every one of them and then reports the first error.
+    auto all = tensorstore::WaitAllFuture(slabs);
+    return tensorstore::MapFuture(
+        tensorstore::InlineExecutor{},
+        [slabs = std::move(slabs)](const tensorstore::Result<void>&) {
+            absl::Status status;
+            for (const auto& slab : slabs) {
+                status.Update(slab.status());
+            }
+            return tensorstore::MakeResult(status);
+        },
+        std::move(all));
+}
+
+extern "C" {
+
+int TSSetDirectWrite(TSDataset* dataset, int enable, TSError* error) {
+    if (!dataset) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        if (!enable) {
+            dataset->direct_write.reset();
+            return 0;
+        }
+#ifndef __linux__
+        SetError(error, absl::UnimplementedError("Direct writes are only supported on Linux"));
+        return -1;
+#else
+        if (dataset->direct_write) {
+            return 0;
+        }
+        auto layout = dataset->store.chunk_layout();
+        if (!layout.ok()) {
+            SetError(error, layout.status());
+            return -1;
+        }
+        auto writer = std::make_unique<DirectWriter>();
+        for (tensorstore::DimensionIndex i = 0; i < layout->rank(); ++i) {
+            const tensorstore::Index extent = layout->write_chunk_shape()[i];
+            if (extent <= 0) {
+                SetError(error, absl::FailedPreconditionError(
+                                    "Dataset has no regular write chunk grid"));
+                return -1;
+            }
+            writer->write_chunk_shape.push_back(extent);
+            const tensorstore::Index grid_origin = layout->grid_origin()[i];
+            writer->grid_origin.push_back(grid_origin != tensorstore::kImplicit ? grid_origin : 0);
+        }
+        // Workers open their own staging arrays; this one only checks that
+        // the dataset can be staged.
+        DirectStaging staging;
+        auto status = OpenStaging(dataset, &staging);
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        dataset->direct_write = std::move(writer);
+        return 0;
+#endif
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,68 @@
+#ifndef TENSORSTORE_DLL_DIRECT_WRITE_H_
+#define TENSORSTORE_DLL_DIRECT_WRITE_H_
+
+#include "tensorstore/array.h"
+#include "tensorstore/index.h"
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/tensorstore.h"
+#include "tensorstore/util/future.h"
+#include "absl/status/status.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct TSDataset;
+
+// Private copy of the dataset's array in a memory kvstore, which write chunks
+// are encoded into before their files are written.
+struct DirectStaging {
+    tensorstore::TensorStore<> store;
+    tensorstore::KvStore kvstore;
+};
+
+// Direct write state of a dataset. Regions made of whole write chunks (or
+// shards) are encoded into a staging array, and the encoded files are then
+// written to disk with O_DIRECT from the context's page-aligned scratch
+// buffers, so they do not pass through the page cache. Each slab of write
+// chunks along dimension 0 is a job of its own, run by a few worker threads
+// that each own a staging array; destroying the writer finishes the queued
+// jobs first.
+struct DirectWriter {
+    static constexpr size_t kMaxWorkers = 4;
+
+    struct Job {
+        std::function<absl::Status(DirectStaging& staging)> run;
+        tensorstore::Promise<void> promise;
+    };
+
+    ~DirectWriter();
+
+    std::vector<tensorstore::Index> write_chunk_shape;
+    std::vector<tensorstore::Index> grid_origin;
+
+    std::mutex mutex;
+    std::condition_variable queue_ready;
+    std::deque<Job> queue;  // Jobs not yet started
+    bool stopping = false;
+    std::vector<std::thread> workers;  // Started as jobs arrive
+};
+
+// True if [origin, origin + shape) consists of whole write chunks, where
+// chunks clipped by the upper bound of the domain count as whole.
+bool IsWholeWriteChunks(TSDataset* dataset, const int64_t* origin, const int64_t* shape);
+
+// Queues jobs that encode `array`, the data for [origin, origin + shape), and
+// write the resulting chunk files with O_DIRECT, one write chunk slab along
+// dimension 0 each. The region must satisfy IsWholeWriteChunks. The returned
+// future completes once every file is in place; `array` must stay valid until
+// then.
+tensorstore::Future<void> StartWriteDirect(TSDataset* dataset, const int64_t* origin,
+                                           const int64_t* shape,
+                                           tensorstore::SharedArray<const void> array);
+
+#endif // TENSORSTORE_DLL_DIRECT_WRITE_H_
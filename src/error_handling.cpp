@@ -1,24 +1,180 @@
 #include "error_handling.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <iterator>
 
-void SetError(TSError* error, const std::string& message, int code) {
+namespace {
+
+std::atomic<int> g_error_mode{TS_ERROR_MODE_HEAP};
+
+// Every message this library stores is preceded by a tag saying how it is
+// owned, so TSClearError can tell heap messages from thread-local buffers on
+// any thread without a field in TSError.
+constexpr uint64_t kHeapTag = 0x746165486572724bULL;
+constexpr uint64_t kBorrowedTag = 0x736c54657272724bULL;
+
+// Backing store for messages in TS_ERROR_MODE_THREAD_LOCAL. Longer messages
+// are truncated. A message set by SetErrorFormat holds only the code name
+// until TSErrorMessage formats the rest from `format` and `args`.
+constexpr size_t kErrorBufferSize = 512;
+struct ThreadError {
+    uint64_t tag = kBorrowedTag;  // Must directly precede `text`
+    char text[kErrorBufferSize];
+    const char* format = nullptr;  // Set while formatting is pending
+    long long args[kMaxErrorFormatArgs];
+};
+thread_local ThreadError t_error;
+
+bool UseThreadLocalBuffer() {
+    return g_error_mode.load(std::memory_order_relaxed) == TS_ERROR_MODE_THREAD_LOCAL;
+}
+
+// Same names as absl::StatusCodeToString, which returns a std::string.
+const char* StatusCodeName(absl::StatusCode code) {
+    switch (code) {
+        case absl::StatusCode::kOk:                 return "OK";
+        case absl::StatusCode::kCancelled:          return "CANCELLED";
+        case absl::StatusCode::kUnknown:            return "UNKNOWN";
+        case absl::StatusCode::kInvalidArgument:    return "INVALID_ARGUMENT";
+        case absl::StatusCode::kDeadlineExceeded:   return "DEADLINE_EXCEEDED";
+        case absl::StatusCode::kNotFound:           return "NOT_FOUND";
+        case absl::StatusCode::kAlreadyExists:      return "ALREADY_EXISTS";
+        case absl::StatusCode::kPermissionDenied:   return "PERMISSION_DENIED";
+        case absl::StatusCode::kResourceExhausted:  return "RESOURCE_EXHAUSTED";
+        case absl::StatusCode::kFailedPrecondition: return "FAILED_PRECONDITION";
+        case absl::StatusCode::kAborted:            return "ABORTED";
+        case absl::StatusCode::kOutOfRange:         return "OUT_OF_RANGE";
+        case absl::StatusCode::kUnimplemented:      return "UNIMPLEMENTED";
+        case absl::StatusCode::kInternal:           return "INTERNAL";
+        case absl::StatusCode::kUnavailable:        return "UNAVAILABLE";
+        case absl::StatusCode::kDataLoss:           return "DATA_LOSS";
+        case absl::StatusCode::kUnauthenticated:    return "UNAUTHENTICATED";
+        default:                                    return "UNKNOWN";
+    }
+}
+
+// Appends `text` at `*pos` of a kErrorBufferSize buffer, truncating at its end.
+void AppendBounded(char* buffer, size_t* pos, const char* text, size_t length) {
+    const size_t n = std::min(length, kErrorBufferSize - 1 - *pos);
+    std::memcpy(buffer + *pos, text, n);
+    *pos += n;
+    buffer[*pos] = '\0';
+}
+
+// Copies `message` to the heap behind a kHeapTag.
+const char* DuplicateMessage(const char* message) {
+    const size_t length = std::strlen(message);
+    char* block = static_cast<char*>(std::malloc(sizeof(uint64_t) + length + 1));
+    if (!block) {
+        return nullptr;
+    }
+    std::memcpy(block, &kHeapTag, sizeof(uint64_t));
+    std::memcpy(block + sizeof(uint64_t), message, length + 1);
+    return block + sizeof(uint64_t);
+}
+
+// Points `error` at `message`, which is the thread-local buffer in
+// TS_ERROR_MODE_THREAD_LOCAL and copied to the heap otherwise.
+void StoreMessage(TSError* error, const char* message, bool thread_local_buffer) {
+    error->message = thread_local_buffer ? message : DuplicateMessage(message);
+}
+
+} // namespace
+
+void SetError(TSError* error, const char* message, int code) {
     if (error) {
-        #ifdef _WIN32
-        error->message = _strdup(message.c_str());
-        #else
-        error->message = strdup(message.c_str());
-        #endif
+        if (UseThreadLocalBuffer()) {
+            size_t pos = 0;
+            t_error.format = nullptr;
+            AppendBounded(t_error.text, &pos, message, std::strlen(message));
+            StoreMessage(error, t_error.text, true);
+        } else {
+            StoreMessage(error, message, false);
+        }
         error->code = code;
     }
 }
 
+void SetError(TSError* error, const std::string& message, int code) {
+    SetError(error, message.c_str(), code);
+}
+
 void SetError(TSError* error, const absl::Status& status) {
     if (error) {
-        #ifdef _WIN32
-        error->message = _strdup(status.ToString().c_str());
-        #else
-        error->message = strdup(status.ToString().c_str());
-        #endif
+        if (UseThreadLocalBuffer()) {
+            // Formats "CODE: message" like Status::ToString, without payloads
+            // and without building an intermediate string.
+            size_t pos = 0;
+            t_error.format = nullptr;
+            const char* name = StatusCodeName(status.code());
+            AppendBounded(t_error.text, &pos, name, std::strlen(name));
+            AppendBounded(t_error.text, &pos, ": ", 2);
+            AppendBounded(t_error.text, &pos, status.message().data(),
+                          status.message().size());
+            StoreMessage(error, t_error.text, true);
+        } else {
+            StoreMessage(error, status.ToString().c_str(), false);
+        }
         error->code = static_cast<int>(status.code());
     }
-}
\ No newline at end of file
+}
+
+void SetErrorFormat(TSError* error, absl::StatusCode code, const char* format,
+                    std::initializer_list<long long> args) {
+    if (!error) {
+        return;
+    }
+    error->code = static_cast<int>(code);
+    size_t pos = 0;
+    const char* name = StatusCodeName(code);
+    if (UseThreadLocalBuffer()) {
+        // Only the code name is written now; the rest waits for TSErrorMessage.
+        AppendBounded(t_error.text, &pos, name, std::strlen(name));
+        t_error.format = format;
+        std::fill(std::begin(t_error.args), std::end(t_error.args), 0);
+        std::copy_n(args.begin(), std::min(args.size(), kMaxErrorFormatArgs), t_error.args);
+        StoreMessage(error, t_error.text, true);
+        return;
+    }
+    char buffer[kErrorBufferSize];
+    AppendBounded(buffer, &pos, name, std::strlen(name));
+    AppendBounded(buffer, &pos, ": ", 2);
+    long long a[kMaxErrorFormatArgs] = {};
+    std::copy_n(args.begin(), std::min(args.size(), kMaxErrorFormatArgs), a);
+    std::snprintf(buffer + pos, kErrorBufferSize - pos, format, a[0], a[1], a[2], a[3], a[4],
+                  a[5]);
+    StoreMessage(error, buffer, false);
+}
+
+const char* ErrorMessage(const TSError* error) {
+    if (error->message == t_error.text && t_error.format) {
+        const long long* a = t_error.args;
+        size_t pos = std::strlen(t_error.text);
+        AppendBounded(t_error.text, &pos, ": ", 2);
+        std::snprintf(t_error.text + pos, kErrorBufferSize - pos, t_error.format, a[0], a[1],
+                      a[2], a[3], a[4], a[5]);
+        t_error.format = nullptr;
+    }
+    return error->message;
+}
+
+void ReleaseErrorMessage(TSError* error) {
+    uint64_t tag;
+    std::memcpy(&tag, error->message - sizeof(uint64_t), sizeof(uint64_t));
+    if (tag == kHeapTag) {
+        std::free(const_cast<char*>(error->message) - sizeof(uint64_t));
+    }
+    error->message = nullptr;
+}
+
+extern "C" {
+
+void TSSetErrorMode(TSErrorMode mode) {
+    g_error_mode.store(mode, std::memory_order_relaxed);
+}
+
+} // extern "C"
@@ -3,9 +3,29 @@
 
 #include "tensorstore_dll/tensorstore_dll.h"
 #include "absl/status/status.h"
+#include <cstddef>
+#include <initializer_list>
 #include <string>
 
+void SetError(TSError* error, const char* message, int code = -1);
 void SetError(TSError* error, const std::string& message, int code = -1);
 void SetError(TSError* error, const absl::Status& status);
+// Arguments SetErrorFormat keeps for a pending message.
+constexpr size_t kMaxErrorFormatArgs = 6;
 
-#endif // TENSORSTORE_DLL_ERROR_HANDLING_H_
\ No newline at end of file
+// Sets a printf-style message, formatted as "CODE: message", where every
+// conversion in `format` takes a long long (%lld). Errors detected by this
+// library use it so that, in TS_ERROR_MODE_THREAD_LOCAL, the failure path does
+// not allocate or format: the thread-local buffer holds just the code name
+// until TSErrorMessage is called. `format` must be a string literal. Messages
+// are truncated to the thread-local buffer size.
+void SetErrorFormat(TSError* error, absl::StatusCode code, const char* format,
+                    std::initializer_list<long long> args);
+
+// Message of `error`, formatting a pending SetErrorFormat message first.
+const char* ErrorMessage(const TSError* error);
+
+// Releases the message of `error` if it was allocated on the heap.
+void ReleaseErrorMessage(TSError* error);
+
+#endif // TENSORSTORE_DLL_ERROR_HANDLING_H_
@@ -0,0 +1,75 @@
+#ifndef TENSORSTORE_DLL_HANDLES_H_
+#define TENSORSTORE_DLL_HANDLES_H_
+
+#include "tensorstore_dll/span_fix.h"  // Must come first
+#include "tensorstore_dll/tensorstore_dll.h"
+#include "data_types.h"
+#include "dataset_cache.h"
+#include "direct_write.h"
+#include "mapped_chunks.h"
+#include "metrics.h"
+#include "metadata.h"
+#include "prefetch.h"
+#include "scratch_pool.h"
+#include "write_back.h"
+
+#include "tensorstore/context.h"
+#include "tensorstore/data_type.h"
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/tensorstore.h"
+#include "tensorstore/util/future.h"
+#include "tensorstore/util/result.h"
+#include <nlohmann/json.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Definitions of the opaque handle types exposed by the C API.
+
+struct TSContext {
+    tensorstore::Context ctx;
+    std::shared_ptr<ContextMetrics> metrics = std::make_shared<ContextMetrics>();
+    std::shared_ptr<ScratchPool> scratch = std::make_shared<ScratchPool>();
+    DatasetCache datasets;  // Arrays opened or created through this context
+    bool io_uring = false;  // Read raw chunk files with io_uring
+};
+
+struct TSDataset {
+    tensorstore::Context context;  // Context the dataset was opened with
+    tensorstore::TensorStore<> store;
+    tensorstore::KvStore kvstore;  // Root of the dataset's storage
+    std::string path;
+    TSDataType dtype;
+    int zarr_format = 2;      // 3 when the array uses the sharding_indexed codec
+    bool raw_chunks = false;  // Chunks are stored uncompressed in C order
+    std::shared_ptr<ContextMetrics> metrics;  // Shared with the owning context
+    std::shared_ptr<ScratchPool> scratch;     // Shared with the owning context
+    std::unique_ptr<Prefetcher> prefetch;     // Set by TSSetPrefetch
+    std::unique_ptr<WriteBackCache> write_back;  // Set by TSSetWriteBackCache
+    std::unique_ptr<MappedChunks> mapped_chunks;  // Set for raw local chunks
+    std::unique_ptr<DirectWriter> direct_write;   // Set by TSSetDirectWrite
+
+    std::mutex metadata_mutex;
+    bool metadata_batch_open = false;
+    ::nlohmann::json metadata_batch = ::nlohmann::json::object();  // Staged updates
+    std::vector<std::string> metadata_keys;  // Backs the pointers from TSListMetadata
+    AttributeCache metadata_cache;
+    bool metadata_check_mtime = false;  // Revalidate the cache against the file
+};
+
+struct TSFuture {
+    tensorstore::Future<void> future;
+};
+
+// Size in bytes of a region of the dataset with the given shape.
+int64_t RegionBytes(TSDataset* dataset, const int64_t* shape);
+
+// Restricts the dataset to [origin, origin + shape), translated to a zero
+// origin so it lines up with a caller buffer of the same shape. The region is
+// bound to `transaction` when one is given.
+tensorstore::Result<tensorstore::TensorStore<>> GetRegion(
+    TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+    const tensorstore::Transaction& transaction = tensorstore::no_transaction);
+
+#endif // TENSORSTORE_DLL_HANDLES_H_
@@ -0,0 +1,325 @@
+#include "handles.h"
+#include "mapped_chunks.h"
+#include "uring_reader.h"
+
+#include "tensorstore/chunk_layout.h"
+#include "tensorstore/util/endian.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Mappings kept open per dataset; the table is dropped when it fills up.
+constexpr size_t kMaxMappedChunks = 1024;
+
+// Chunk files read per io_uring batch.
+constexpr size_t kUringBatchChunks = 128;
+
+#ifndef _WIN32
+
+ChunkFileStamp ToStamp(const struct stat& info) {
+    ChunkFileStamp stamp;
+    stamp.id = static_cast<uint64_t>(info.st_ino);
+#ifdef __APPLE__
+    stamp.mtime = int64_t{info.st_mtimespec.tv_sec} * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    stamp.mtime = int64_t{info.st_mtim.tv_sec} * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    stamp.size = static_cast<uint64_t>(info.st_size);
+    return stamp;
+}
+
+absl::Status ErrnoError(const char* operation, const std::string& path) {
+    return absl::ErrnoToStatus(errno, absl::StrCat(operation, " ", path));
+}
+
+#endif
+
+// Advances `position` over the box [first, last] in C order. Returns false
+// once every position has been visited. Only the first `rank` dimensions
+// take part.
+bool NextPosition(std::vector<tensorstore::Index>& position,
+                  const std::vector<tensorstore::Index>& first,
+                  const std::vector<tensorstore::Index>& last, size_t rank) {
+    for (size_t d = rank; d-- > 0;) {
+        if (++position[d] <= last[d]) return true;
+        position[d] = first[d];
+    }
+    return false;
+}
+
+// Copies the parts of full chunks that fall inside a region into the
+// caller's buffer.
+class RegionCopy {
+public:
+    RegionCopy(const MappedChunks& chunks, const int64_t* origin, const int64_t* shape,
+               void* data, const int64_t* byte_strides)
+        : chunk_shape_(chunks.chunk_shape),
+          element_size_(chunks.element_size),
+          origin_(origin),
+          shape_(shape),
+          data_(static_cast<char*>(data)),
+          dest_strides_(chunk_shape_.size()),
+          source_strides_(chunk_shape_.size()),
+          lo_(chunk_shape_.size()),
+          hi_(chunk_shape_.size()),
+          row_(chunk_shape_.size()) {
+        tensorstore::Index dest_stride = element_size_;
+        tensorstore::Index source_stride = element_size_;
+        for (size_t i = chunk_shape_.size(); i-- > 0;) {
+            dest_strides_[i] = byte_strides ? byte_strides[i] : dest_stride;
+            source_strides_[i] = source_stride;
+            dest_stride *= shape[i];
+            source_stride *= chunk_shape_[i];
+        }
+    }
+
+    // `source` holds the full chunk at grid position `chunk` in C order.
+    void CopyChunk(const char* source, const std::vector<tensorstore::Index>& chunk) {
+        const size_t rank = chunk_shape_.size();
+        for (size_t i = 0; i < rank; ++i) {
+            const tensorstore::Index chunk_origin = chunk[i] * chunk_shape_[i];
+            lo_[i] = std::max<tensorstore::Index>(origin_[i], chunk_origin);
+            hi_[i] = std::min<tensorstore::Index>(origin_[i] + shape_[i],
+                                                  chunk_origin + chunk_shape_[i]) - 1;
+        }
+        // Copy the intersection one innermost row at a time.
+        const tensorstore::Index run = hi_[rank - 1] - lo_[rank - 1] + 1;
+        const bool contiguous_rows = dest_strides_[rank - 1] == element_size_;
+        row_ = lo_;
+        do {
+            const char* from = source;
+            char* to = data_;
+            for (size_t i = 0; i < rank; ++i) {
+                from += (row_[i] - chunk[i] * chunk_shape_[i]) * source_strides_[i];
+                to += (row_[i] - origin_[i]) * dest_strides_[i];
+            }
+            if (contiguous_rows) {
+                std::memcpy(to, from, run * element_size_);
+            } else {
+                for (tensorstore::Index j = 0; j < run; ++j) {
+                    std::memcpy(to + j * dest_strides_[rank - 1], from + j * element_size_,
+                                element_size_);
+                }
+            }
+        } while (NextPosition(row_, lo_, hi_, rank - 1));
+    }
+
+private:
+    const std::vector<tensorstore::Index>& chunk_shape_;
+    const tensorstore::Index element_size_;
+    const int64_t* origin_;
+    const int64_t* shape_;
+    char* data_;
+    std::vector<tensorstore::Index> dest_strides_, source_strides_;
+    std::vector<tensorstore::Index> lo_, hi_, row_;
+};
+
+} // namespace
+
+#ifndef _WIN32
+
+tensorstore::Result<std::shared_ptr<const MappedFile>> MappedFile::Open(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return std::shared_ptr<const MappedFile>();
+        return ErrnoError("Failed to open", path);
+    }
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        auto status = ErrnoError("Failed to stat", path);
+        ::close(fd);
+        return status;
+    }
+    file->stamp_ = ToStamp(info);
+    file->size_ = static_cast<size_t>(info.st_size);
+    if (file->size_ > 0) {
+        void* data = ::mmap(nullptr, file->size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            auto status = ErrnoError("Failed to map", path);
+            ::close(fd);
+            return status;
+        }
+        file->data_ = static_cast<const char*>(data);
+    }
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    return std::shared_ptr<const MappedFile>(std::move(file));
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#else
+
+tensorstore::Result<std::shared_ptr<const MappedFile>> MappedFile::Open(const std::string&) {
+    return absl::UnimplementedError("Mapped chunk files are not supported on Windows");
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
+
+std::unique_ptr<MappedChunks> CreateMappedChunks(TSDataset* dataset) {
+#ifdef _WIN32
+    (void)dataset;
+    return nullptr;
+#else
+    if (!dataset->raw_chunks || tensorstore::endian::native != tensorstore::endian::little) {
+        return nullptr;
+    }
+    auto layout = dataset->store.chunk_layout();
+    if (!layout.ok()) {
+        return nullptr;
+    }
+    auto chunks = std::make_unique<MappedChunks>();
+    chunks->root = dataset->path;
+    chunks->element_size = ToTensorstoreDataType(dataset->dtype).size();
+    chunks->chunk_bytes = chunks->element_size;
+    for (tensorstore::Index extent : layout->read_chunk_shape()) {
+        if (extent <= 0) return nullptr;
+        chunks->chunk_shape.push_back(extent);
+        chunks->chunk_bytes *= extent;
+    }
+    return chunks;
+#endif
+}
+
+tensorstore::Result<std::shared_ptr<const MappedFile>> MapChunk(
+    MappedChunks* chunks, const std::vector<tensorstore::Index>& grid_position) {
+#ifdef _WIN32
+    return absl::UnimplementedError("Mapped chunk files are not supported on Windows");
+#else
+    const std::string key = absl::StrJoin(grid_position, ".");
+    const std::string path = absl::StrCat(chunks->root, "/", key);
+
+    // One stat per access catches chunks rewritten through any handle.
+    struct stat info;
+    const bool exists = ::stat(path.c_str(), &info) == 0;
+    if (!exists && errno != ENOENT) {
+        return ErrnoError("Failed to stat", path);
+    }
+    std::lock_guard<std::mutex> lock(chunks->mutex);
+    auto it = chunks->files.find(key);
+    if (!exists) {
+        if (it != chunks->files.end()) chunks->files.erase(it);
+        return std::shared_ptr<const MappedFile>();
+    }
+    if (it != chunks->files.end() && it->second->stamp() == ToStamp(info)) {
+        return it->second;
+    }
+
+    auto file = MappedFile::Open(path);
+    if (!file.ok()) {
+        return file.status();
+    }
+    if (!*file || static_cast<tensorstore::Index>((*file)->size()) != chunks->chunk_bytes) {
+        return std::shared_ptr<const MappedFile>();
+    }
+    if (chunks->files.size() >= kMaxMappedChunks) {
+        chunks->files.clear();
+    }
+    chunks->files[key] = *file;
+    return *file;
+#endif
+}
+
+tensorstore::Result<bool> ReadMapped(TSDataset* dataset, const int64_t* origin,
+                                     const int64_t* shape, void* data,
+                                     const int64_t* byte_strides) {
+    MappedChunks* chunks = dataset->mapped_chunks.get();
+    const size_t rank = chunks->chunk_shape.size();
+    auto domain = dataset->store.domain();
+    // Anything unusual is left to tensorstore, which also reports the errors.
+    if (static_cast<size_t>(domain.rank()) != rank || rank == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < rank; ++i) {
+        if (shape[i] <= 0 || origin[i] < domain[i].inclusive_min() || origin[i] < 0 ||
+            origin[i] + shape[i] > domain[i].exclusive_max()) {
+            return false;
+        }
+    }
+
+    RegionCopy copy(*chunks, origin, shape, data, byte_strides);
+    std::vector<tensorstore::Index> first_chunk(rank), last_chunk(rank);
+    for (size_t i = 0; i < rank; ++i) {
+        first_chunk[i] = origin[i] / chunks->chunk_shape[i];
+        last_chunk[i] = (origin[i] + shape[i] - 1) / chunks->chunk_shape[i];
+    }
+    std::vector<tensorstore::Index> chunk = first_chunk;
+
+    if (!chunks->io_uring) {
+        do {
+            auto file = MapChunk(chunks, chunk);
+            if (!file.ok()) {
+                return file.status();
+            }
+            if (!*file) {
+                return false;
+            }
+            copy.CopyChunk((*file)->data(), chunk);
+        } while (NextPosition(chunk, first_chunk, last_chunk, rank));
+        return true;
+    }
+
+    // Chunk files are read a batch at a time into a staging buffer, with
+    // every read of the batch queued on the device at once.
+    ScratchPool::Buffer buffer;
+    std::vector<FileRead> reads;
+    std::vector<std::vector<tensorstore::Index>> positions;
+    bool more = true;
+    while (more) {
+        reads.clear();
+        positions.clear();
+        while (more && positions.size() < kUringBatchChunks) {
+            positions.push_back(chunk);
+            more = NextPosition(chunk, first_chunk, last_chunk, rank);
+        }
+        if (!buffer.data()) {
+            buffer = dataset->scratch->Acquire(positions.size() * chunks->chunk_bytes);
+        }
+        for (size_t i = 0; i < positions.size(); ++i) {
+            FileRead read;
+            read.path = absl::StrCat(chunks->root, "/", absl::StrJoin(positions[i], "."));
+            read.buffer = buffer.data() + i * chunks->chunk_bytes;
+            read.size = chunks->chunk_bytes;
+            reads.push_back(std::move(read));
+        }
+        // On failure the region is read again through tensorstore, which
+        // reports any error that is not specific to io_uring.
+        if (!UringReadFiles(reads).ok()) {
+            for (const FileRead& read : reads) {
+                if (read.in_flight) {
+                    buffer.Leak();
+                    break;
+                }
+            }
+            return false;
+        }
+        for (size_t i = 0; i < positions.size(); ++i) {
+            if (!reads[i].found ||
+                static_cast<tensorstore::Index>(reads[i].bytes_read) != chunks->chunk_bytes) {
+                return false;
+            }
+            copy.CopyChunk(reads[i].buffer, positions[i]);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef TENSORSTORE_DLL_MAPPED_CHUNKS_H_
+#define TENSORSTORE_DLL_MAPPED_CHUNKS_H_
+
+#include "tensorstore/index.h"
+#include "tensorstore/util/result.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TSDataset;
+
+// Identity of a chunk file's contents: tensorstore replaces chunk files by
+// renaming a new file over them, so a changed file has a new inode.
+struct ChunkFileStamp {
+    uint64_t id = 0;     // Inode
+    int64_t mtime = 0;   // Nanoseconds
+    uint64_t size = 0;
+
+    bool operator==(const ChunkFileStamp& other) const {
+        return id == other.id && mtime == other.mtime && size == other.size;
+    }
+};
+
+// Read-only memory mapping of a whole file. Tensorstore never truncates a
+// chunk file in place, so the mapping stays valid after the file is replaced;
+// it then just shows the old contents.
+class MappedFile {
+public:
+    // Maps the file at `path`, or returns null if it does not exist.
+    static tensorstore::Result<std::shared_ptr<const MappedFile>> Open(const std::string& path);
+
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    const ChunkFileStamp& stamp() const { return stamp_; }
+
+private:
+    MappedFile() = default;
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    ChunkFileStamp stamp_;
+};
+
+// Direct access to the chunk files of an uncompressed zarr v2 dataset stored
+// on the local file system. Chunks are stored at full size in C order under "i.j.k", so a
+// mapped chunk file already holds the decoded chunk.
+struct MappedChunks {
+    std::string root;                          // Dataset directory
+    std::vector<tensorstore::Index> chunk_shape;
+    tensorstore::Index element_size = 0;
+    tensorstore::Index chunk_bytes = 0;
+    bool io_uring = false;  // ReadMapped reads the files with io_uring instead
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const MappedFile>> files;  // By chunk key
+};
+
+// Sets up mapped access for `dataset` if its chunks are raw and the host is
+// little endian; returns null otherwise, and always on Windows, where an
+// open mapping would make tensorstore's rename over the chunk file fail.
+std::unique_ptr<MappedChunks> CreateMappedChunks(TSDataset* dataset);
+
+// Returns the mapping of the chunk at `grid_position`, remapping it if the
+// file changed since it was last mapped. Returns null if the chunk is missing
+// or not stored at full size.
+tensorstore::Result<std::shared_ptr<const MappedFile>> MapChunk(
+    MappedChunks* chunks, const std::vector<tensorstore::Index>& grid_position);
+
+// Copies [origin, origin + shape) out of the chunk files into `data`,
+// laid out with `byte_strides` (C order if null). Returns false, with `data`
+// partially written, if a chunk is missing or an io_uring batch fails, so the
+// caller can fall back to a regular read that fills it in.
+tensorstore::Result<bool> ReadMapped(TSDataset* dataset, const int64_t* origin,
+                                     const int64_t* shape, void* data,
+                                     const int64_t* byte_strides);
+
+#endif // TENSORSTORE_DLL_MAPPED_CHUNKS_H_
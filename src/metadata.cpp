@@ -0,0 +1,325 @@
+#include "handles.h"
+#include "metadata.h"
+#include "error_handling.h"
+
+#include "tensorstore/kvstore/operations.h"
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include <nlohmann/json.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+namespace {
+
+// Zarr v2 keeps user attributes in their own file; zarr v3 embeds them in
+// the array metadata. Tensorstore has no call to update v3 attributes, so
+// zarr.json is patched directly and open TensorStore handles keep the array
+// metadata they loaded.
+const char* AttributesKey(const TSDataset* dataset) {
+    return dataset->zarr_format == 3 ? "zarr.json" : ".zattrs";
+}
+
+// Parses the stored attributes file. A missing file is an empty document.
+tensorstore::Result<::nlohmann::json> ReadAttributesFile(TSDataset* dataset) {
+    auto read = tensorstore::kvstore::Read(dataset->kvstore, AttributesKey(dataset)).result();
+    if (!read.ok()) {
+        return read.status();
+    }
+    if (!read->has_value()) {
+        return ::nlohmann::json::object();
+    }
+    auto json = ::nlohmann::json::parse(std::string(read->value), nullptr,
+                                        /*allow_exceptions=*/false);
+    if (json.is_discarded() || !json.is_object()) {
+        return absl::DataLossError(
+            absl::StrCat("Invalid JSON object in ", AttributesKey(dataset)));
+    }
+    return json;
+}
+
+// Extracts the attributes object from a parsed attributes file.
+::nlohmann::json AttributesOf(const TSDataset* dataset, const ::nlohmann::json& file) {
+    if (dataset->zarr_format != 3) {
+        return file;
+    }
+    auto it = file.find("attributes");
+    return it != file.end() && it->is_object() ? *it : ::nlohmann::json::object();
+}
+
+FileStamp StatAttributesFile(const TSDataset* dataset) {
+    const std::filesystem::path path =
+        std::filesystem::path(dataset->path) / AttributesKey(dataset);
+    FileStamp stamp;
+    std::error_code ec;
+    stamp.mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return stamp;
+    }
+    stamp.size = std::filesystem::file_size(path, ec);
+    stamp.exists = !ec;
+    return stamp;
+}
+
+void FillCache(TSDataset* dataset, ::nlohmann::json attributes, const FileStamp& stamp) {
+    AttributeCache& cache = dataset->metadata_cache;
+    cache.attributes = std::move(attributes);
+    cache.values.clear();
+    cache.values.reserve(cache.attributes.size());
+    for (auto it = cache.attributes.begin(); it != cache.attributes.end(); ++it) {
+        // Values set through TSSetMetadata are strings; anything else is
+        // returned as serialized JSON.
+        cache.values.emplace(it.key(), it->is_string() ? it->get<std::string>() : it->dump());
+    }
+    cache.stamp = stamp;
+    cache.valid = true;
+}
+
+// Returns the cached attributes, reloading them on first use or when the
+// attributes file was changed behind this handle's back. The file is stat'ed
+// before it is read, so a concurrent change is caught by the next check.
+tensorstore::Result<const AttributeCache*> LoadAttributes(TSDataset* dataset) {
+    AttributeCache& cache = dataset->metadata_cache;
+    if (cache.valid && !dataset->metadata_check_mtime) {
+        return &cache;
+    }
+    const FileStamp stamp = StatAttributesFile(dataset);
+    if (cache.valid && cache.stamp == stamp) {
+        return &cache;
+    }
+    auto file = ReadAttributesFile(dataset);
+    if (!file.ok()) {
+        return file.status();
+    }
+    FillCache(dataset, AttributesOf(dataset, *file), stamp);
+    return &cache;
+}
+
+// Merges `updates` into the stored attributes with a single read-modify-write
+// of the attributes file.
+absl::Status UpdateAttributes(TSDataset* dataset, const ::nlohmann::json& updates) {
+    if (updates.empty()) {
+        return absl::OkStatus();
+    }
+    auto file = ReadAttributesFile(dataset);
+    if (!file.ok()) {
+        return file.status();
+    }
+    ::nlohmann::json& attributes = dataset->zarr_format == 3 ? (*file)["attributes"] : *file;
+    if (!attributes.is_object()) {
+        attributes = ::nlohmann::json::object();
+    }
+    attributes.update(updates);
+    auto written = tensorstore::kvstore::Write(dataset->kvstore, AttributesKey(dataset),
+                                               absl::Cord(file->dump()))
+                       .result();
+    if (!written.ok()) {
+        dataset->metadata_cache.valid = false;
+        return written.status();
+    }
+    FillCache(dataset, attributes, StatAttributesFile(dataset));
+    return absl::OkStatus();
+}
+
+// Stages `updates` when a batch is open, otherwise writes them through.
+absl::Status ApplyUpdates(TSDataset* dataset, const ::nlohmann::json& updates) {
+    std::lock_guard<std::mutex> lock(dataset->metadata_mutex);
+    if (dataset->metadata_batch_open) {
+        dataset->metadata_batch.update(updates);
+        return absl::OkStatus();
+    }
+    return UpdateAttributes(dataset, updates);
+}
+
+int CopyString(const std::string& value, char* buf, size_t buf_size, TSError* error) {
+    if (value.size() >= buf_size) {
+        SetError(error, absl::ResourceExhaustedError(absl::StrCat(
+                            "Value buffer too small, need ", value.size() + 1, " bytes")));
+        return -1;
+    }
+    std::memcpy(buf, value.c_str(), value.size() + 1);
+    return 0;
+}
+
+} // namespace
+
+extern "C" {
+
+int TSSetMetadata(TSDataset* dataset, const char* key, const char* value, TSError* error) {
+    if (!dataset || !key || !value) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        auto status = ApplyUpdates(dataset, {{key, value}});
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSSetMetadataJSON(TSDataset* dataset, const char* json, TSError* error) {
+    if (!dataset || !json) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    auto updates = ::nlohmann::json::parse(json, nullptr, /*allow_exceptions=*/false);
+    if (updates.is_discarded() || !updates.is_object()) {
+        SetError(error, absl::InvalidArgumentError("Metadata is not a JSON object"));
+        return -1;
+    }
+    try {
+        auto status = ApplyUpdates(dataset, updates);
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSBeginMetadataBatch(TSDataset* dataset, TSError* error) {
+    if (!dataset) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(dataset->metadata_mutex);
+    if (dataset->metadata_batch_open) {
+        SetError(error, absl::FailedPreconditionError("A metadata batch is already open"));
+        return -1;
+    }
+    dataset->metadata_batch_open = true;
+    dataset->metadata_batch = ::nlohmann::json::object();
+    return 0;
+}
+
+int TSCommitMetadataBatch(TSDataset* dataset, TSError* error) {
+    if (!dataset) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        std::lock_guard<std::mutex> lock(dataset->metadata_mutex);
+        if (!dataset->metadata_batch_open) {
+            SetError(error, absl::FailedPreconditionError("No metadata batch is open"));
+            return -1;
+        }
+        // The batch is closed even if the write fails, so a failed commit
+        // does not leave later updates silently staged.
+        ::nlohmann::json updates = std::move(dataset->metadata_batch);
+        dataset->metadata_batch = ::nlohmann::json::object();
+        dataset->metadata_batch_open = false;
+        auto status = UpdateAttributes(dataset, updates);
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSGetMetadata(TSDataset* dataset, const char* key, char* value, size_t value_size,
+                  TSError* error) {
+    if (!dataset || !key || !value || value_size == 0) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        std::lock_guard<std::mutex> lock(dataset->metadata_mutex);
+        if (dataset->metadata_batch_open) {
+            auto staged = dataset->metadata_batch.find(key);
+            if (staged != dataset->metadata_batch.end()) {
+                return CopyString(staged->is_string() ? staged->get<std::string>()
+                                                      : staged->dump(),
+                                  value, value_size, error);
+            }
+        }
+        auto cache = LoadAttributes(dataset);
+        if (!cache.ok()) {
+            SetError(error, cache.status());
+            return -1;
+        }
+        auto it = (*cache)->values.find(key);
+        if (it == (*cache)->values.end()) {
+            SetError(error, absl::NotFoundError(absl::StrCat("Metadata key not found: ", key)));
+            return -1;
+        }
+        return CopyString(it->second, value, value_size, error);
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSListMetadata(TSDataset* dataset, char** keys, size_t* num_keys, TSError* error) {
+    if (!dataset || !num_keys) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        std::lock_guard<std::mutex> lock(dataset->metadata_mutex);
+        auto cache = LoadAttributes(dataset);
+        if (!cache.ok()) {
+            SetError(error, cache.status());
+            return -1;
+        }
+        const ::nlohmann::json* attributes = &(*cache)->attributes;
+        ::nlohmann::json merged;
+        if (dataset->metadata_batch_open && !dataset->metadata_batch.empty()) {
+            merged = *attributes;
+            merged.update(dataset->metadata_batch);
+            attributes = &merged;
+        }
+        // A null `keys` only queries the count; otherwise `*num_keys` is the
+        // capacity of `keys`.
+        if (!keys) {
+            *num_keys = attributes->size();
+            return 0;
+        }
+        if (attributes->size() > *num_keys) {
+            SetError(error, absl::ResourceExhaustedError(absl::StrCat(
+                                "Key array too small, need ", attributes->size(), " entries")));
+            *num_keys = attributes->size();
+            return -1;
+        }
+        dataset->metadata_keys.clear();
+        for (auto it = attributes->begin(); it != attributes->end(); ++it) {
+            dataset->metadata_keys.push_back(it.key());
+        }
+        *num_keys = dataset->metadata_keys.size();
+        for (size_t i = 0; i < dataset->metadata_keys.size(); ++i) {
+            keys[i] = &dataset->metadata_keys[i][0];
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSSetMetadataCheckMtime(TSDataset* dataset, int enabled, TSError* error) {
+    if (!dataset) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(dataset->metadata_mutex);
+    dataset->metadata_check_mtime = enabled != 0;
+    return 0;
+}
+
+} // extern "C"
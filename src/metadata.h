@@ -0,0 +1,30 @@
+#ifndef TENSORSTORE_DLL_METADATA_H_
+#define TENSORSTORE_DLL_METADATA_H_
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+// Identity of a file's contents as far as a stat() call can tell.
+struct FileStamp {
+    bool exists = false;
+    std::filesystem::file_time_type mtime;
+    uintmax_t size = 0;
+
+    bool operator==(const FileStamp& other) const {
+        return exists == other.exists && mtime == other.mtime && size == other.size;
+    }
+};
+
+// Parsed user attributes of a dataset with a hashed index of their values.
+struct AttributeCache {
+    bool valid = false;
+    FileStamp stamp;  // Attributes file state the cache was loaded from
+    ::nlohmann::json attributes = ::nlohmann::json::object();
+    std::unordered_map<std::string, std::string> values;  // As returned by TSGetMetadata
+};
+
+#endif // TENSORSTORE_DLL_METADATA_H_
@@ -0,0 +1,125 @@
+#include "handles.h"
+#include "metrics.h"
+#include "error_handling.h"
+
+#ifdef TENSORSTORE_DLL_TENSORSTORE_METRICS
+#include "tensorstore/internal/metrics/collect.h"
+#include "tensorstore/internal/metrics/registry.h"
+#endif
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+#include <cstring>
+#include <string>
+
+namespace {
+
+const char* const kOperationNames[ContextMetrics::kNumOperations] = {"read", "write"};
+
+#ifdef TENSORSTORE_DLL_TENSORSTORE_METRICS
+// Tensorstore's own counters for the chunk cache (hits, misses, evictions,
+// chunk reads and writes) and the file kvstore (bytes and operations). These
+// are process-wide rather than per context, and come from tensorstore's
+// internal metrics registry, which is not part of its public API.
+const char* const kTensorstoreMetricPrefixes[] = {
+    "/tensorstore/cache/",
+    "/tensorstore/kvstore/file/",
+};
+#endif
+
+int LatencyBucket(int64_t latency_us) {
+    int bucket = 0;
+    while (bucket < ContextMetrics::kLatencyBuckets - 1 && (int64_t{1} << bucket) <= latency_us) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+} // namespace
+
+::nlohmann::json ContextMetrics::ToJson() const {
+    ::nlohmann::json result;
+    for (int op = 0; op < kNumOperations; ++op) {
+        const OperationCounters& counters = operations[op];
+        ::nlohmann::json bounds = ::nlohmann::json::array();
+        ::nlohmann::json counts = ::nlohmann::json::array();
+        for (int i = 0; i < kLatencyBuckets; ++i) {
+            bounds.push_back(int64_t{1} << i);
+            counts.push_back(counters.latency_us[i].load(std::memory_order_relaxed));
+        }
+        result["operations"][kOperationNames[op]] = {
+            {"count", counters.count.load(std::memory_order_relaxed)},
+            {"failures", counters.failures.load(std::memory_order_relaxed)},
+            {"bytes", counters.bytes.load(std::memory_order_relaxed)},
+            {"latency_us", {{"upper_bounds", bounds}, {"counts", counts}}},
+        };
+    }
+    result["in_flight"] = in_flight.load(std::memory_order_relaxed);
+    result["prefetched_chunks"] = prefetched_chunks.load(std::memory_order_relaxed);
+
+#ifdef TENSORSTORE_DLL_TENSORSTORE_METRICS
+    ::nlohmann::json collected = ::nlohmann::json::array();
+    for (const char* prefix : kTensorstoreMetricPrefixes) {
+        for (const auto& metric :
+             tensorstore::internal_metrics::GetMetricRegistry().CollectWithPrefix(prefix)) {
+            collected.push_back(tensorstore::internal_metrics::CollectedMetricToJson(metric));
+        }
+    }
+    result["tensorstore"] = std::move(collected);
+#else
+    // Present but null, so readers can tell the counters were not collected.
+    result["tensorstore"] = nullptr;
+#endif
+    return result;
+}
+
+void TrackOperation(const std::shared_ptr<ContextMetrics>& metrics,
+                    ContextMetrics::Operation operation, int64_t bytes,
+                    const tensorstore::Future<void>& future) {
+    if (!metrics) {
+        return;
+    }
+    metrics->in_flight.fetch_add(1, std::memory_order_relaxed);
+    const absl::Time start = absl::Now();
+    future.ExecuteWhenReady(
+        [metrics, operation, bytes, start](tensorstore::ReadyFuture<void> ready) {
+            auto& counters = metrics->operations[operation];
+            const int64_t latency_us = absl::ToInt64Microseconds(absl::Now() - start);
+            counters.count.fetch_add(1, std::memory_order_relaxed);
+            if (ready.status().ok()) {
+                counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+            } else {
+                counters.failures.fetch_add(1, std::memory_order_relaxed);
+            }
+            counters.latency_us[LatencyBucket(latency_us)].fetch_add(1, std::memory_order_relaxed);
+            metrics->in_flight.fetch_sub(1, std::memory_order_relaxed);
+        });
+}
+
+extern "C" {
+
+int TSGetMetrics(TSContext* context, char* json_buf, size_t buf_size, TSError* error) {
+    if (!context || !json_buf || buf_size == 0) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        ::nlohmann::json metrics = context->metrics->ToJson();
+        metrics["scratch_pool"] = context->scratch->ToJson();
+        const std::string json = metrics.dump();
+        if (json.size() >= buf_size) {
+            SetError(error, absl::ResourceExhaustedError(absl::StrCat(
+                                "Metrics buffer too small, need ", json.size() + 1, " bytes")));
+            return -1;
+        }
+        std::memcpy(json_buf, json.c_str(), json.size() + 1);
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,40 @@
+#ifndef TENSORSTORE_DLL_METRICS_H_
+#define TENSORSTORE_DLL_METRICS_H_
+
+#include "tensorstore/util/future.h"
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Per-context I/O counters. Datasets share their context's instance so the
+// counters stay valid even if the context handle is destroyed first.
+struct ContextMetrics {
+    enum Operation { kRead = 0, kWrite = 1, kNumOperations };
+
+    // Latency bucket i counts operations that took less than 2^i microseconds;
+    // the last bucket also collects everything slower.
+    static constexpr int kLatencyBuckets = 28;
+
+    struct OperationCounters {
+        std::atomic<int64_t> count{0};
+        std::atomic<int64_t> failures{0};
+        std::atomic<int64_t> bytes{0};
+        std::atomic<int64_t> latency_us[kLatencyBuckets] = {};
+    };
+
+    OperationCounters operations[kNumOperations];
+    std::atomic<int64_t> in_flight{0};
+    std::atomic<int64_t> prefetched_chunks{0};  // Chunks loaded by completed read-ahead
+
+    ::nlohmann::json ToJson() const;
+};
+
+// Counts `future` as an in-flight operation of `bytes` bytes and records its
+// outcome and latency once it completes.
+void TrackOperation(const std::shared_ptr<ContextMetrics>& metrics,
+                    ContextMetrics::Operation operation, int64_t bytes,
+                    const tensorstore::Future<void>& future);
+
+#endif // TENSORSTORE_DLL_METRICS_H_
@@ -0,0 +1,146 @@
+#include "handles.h"
+#include "prefetch.h"
+#include "error_handling.h"
+
+#include "tensorstore/chunk_layout.h"
+#include "tensorstore/index_space/dim_expression.h"
+#include "tensorstore/tensorstore.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+int64_t ChunkFloor(const Prefetcher& prefetcher, int dim, int64_t position) {
+    const int64_t offset = position - prefetcher.grid_origin[dim];
+    const int64_t depth = prefetcher.chunk_shape[dim];
+    return prefetcher.grid_origin[dim] + offset / depth * depth;
+}
+
+int64_t ChunkCeil(const Prefetcher& prefetcher, int dim, int64_t position) {
+    return ChunkFloor(prefetcher, dim, position + prefetcher.chunk_shape[dim] - 1);
+}
+
+bool IsSequential(const Prefetcher& prefetcher, const int64_t* origin, const int64_t* shape) {
+    const size_t rank = prefetcher.last_origin.size();
+    for (size_t i = 0; i < rank; ++i) {
+        if (static_cast<int>(i) == prefetcher.dimension) {
+            if (origin[i] != prefetcher.last_origin[i] + prefetcher.last_shape[i]) return false;
+        } else if (origin[i] != prefetcher.last_origin[i] ||
+                   shape[i] != prefetcher.last_shape[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void NotePrefetchAccess(TSDataset* dataset, const int64_t* origin, const int64_t* shape) {
+    Prefetcher* prefetcher = dataset->prefetch.get();
+    if (!prefetcher) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(prefetcher->mutex);
+    while (!prefetcher->pending.empty() && prefetcher->pending.front().ready()) {
+        prefetcher->pending.pop_front();
+    }
+
+    const int dim = prefetcher->dimension;
+    const bool sequential = !prefetcher->last_origin.empty() &&
+                            IsSequential(*prefetcher, origin, shape);
+    const int rank = static_cast<int>(dataset->store.rank());
+    prefetcher->last_origin.assign(origin, origin + rank);
+    prefetcher->last_shape.assign(shape, shape + rank);
+    if (!sequential) {
+        // A jump invalidates the read-ahead window; in-flight reads are left
+        // to finish since their chunks may still be useful.
+        prefetcher->prefetched_until = 0;
+        return;
+    }
+
+    // The chunk holding the end of this read was decoded by the read itself,
+    // so the window starts at the next chunk boundary.
+    const int64_t end = origin[dim] + shape[dim];
+    const int64_t limit = dataset->store.domain()[dim].exclusive_max();
+    const int64_t start =
+        std::max(ChunkCeil(*prefetcher, dim, end), prefetcher->prefetched_until);
+    const int64_t stop = std::min(ChunkCeil(*prefetcher, dim, end) +
+                                      prefetcher->num_chunks * prefetcher->chunk_shape[dim],
+                                  limit);
+    if (start >= stop) {
+        return;
+    }
+
+    // One element per chunk of the window, at the start of each chunk.
+    std::vector<int64_t> sample_origin(rank);
+    std::vector<int64_t> sample_count(rank);
+    std::vector<int64_t> sample_stride(rank);
+    for (int i = 0; i < rank; ++i) {
+        const int64_t lo = i == dim ? start : origin[i];
+        const int64_t hi = i == dim ? stop : origin[i] + shape[i];
+        sample_stride[i] = prefetcher->chunk_shape[i];
+        sample_origin[i] = ChunkFloor(*prefetcher, i, lo);
+        sample_count[i] = (hi - sample_origin[i] + sample_stride[i] - 1) / sample_stride[i];
+    }
+    auto region = dataset->store |
+                  tensorstore::AllDims().TranslateSizedInterval(
+                      tensorstore::span<const tensorstore::Index>(sample_origin),
+                      tensorstore::span<const tensorstore::Index>(sample_count),
+                      tensorstore::span<const tensorstore::Index>(sample_stride));
+    if (!region.ok()) {
+        return;
+    }
+    // The samples are discarded; the read only warms the chunk cache.
+    // Holding the future keeps tensorstore from cancelling it.
+    auto future = tensorstore::Read<tensorstore::zero_origin>(*region);
+    future.ExecuteWhenReady(
+        [metrics = dataset->metrics](
+            tensorstore::ReadyFuture<tensorstore::SharedArray<void>> ready) {
+            if (metrics && ready.result().ok()) {
+                metrics->prefetched_chunks.fetch_add(ready.value().num_elements(),
+                                                     std::memory_order_relaxed);
+            }
+        });
+    prefetcher->pending.push_back(std::move(future));
+    prefetcher->prefetched_until = stop;
+}
+
+extern "C" {
+
+int TSSetPrefetch(TSDataset* dataset, int dimension, int num_chunks, TSError* error) {
+    if (!dataset || dimension < 0 || dimension >= dataset->store.rank() || num_chunks < 0) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        if (num_chunks == 0) {
+            dataset->prefetch.reset();
+            return 0;
+        }
+        auto layout = dataset->store.chunk_layout();
+        if (!layout.ok()) {
+            SetError(error, layout.status());
+            return -1;
+        }
+        auto prefetcher = std::make_unique<Prefetcher>();
+        prefetcher->dimension = dimension;
+        prefetcher->num_chunks = num_chunks;
+        for (tensorstore::DimensionIndex i = 0; i < dataset->store.rank(); ++i) {
+            const tensorstore::Index chunk = layout->read_chunk_shape()[i];
+            const tensorstore::Index grid_origin = layout->grid_origin()[i];
+            prefetcher->chunk_shape.push_back(chunk > 0 ? chunk : 1);
+            prefetcher->grid_origin.push_back(grid_origin != tensorstore::kImplicit ? grid_origin
+                                                                                   : 0);
+        }
+        dataset->prefetch = std::move(prefetcher);
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+} // extern "C"
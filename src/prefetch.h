@@ -0,0 +1,38 @@
+#ifndef TENSORSTORE_DLL_PREFETCH_H_
+#define TENSORSTORE_DLL_PREFETCH_H_
+
+#include "tensorstore/array.h"
+#include "tensorstore/index.h"
+#include "tensorstore/util/future.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct TSDataset;
+
+// Read-ahead state of a dataset. Reads that continue exactly where the
+// previous one ended along `dimension` (with the same extent in every other
+// dimension) are treated as sequential, and the next `num_chunks` chunks
+// along that dimension are read in the background so they are decoded into
+// the context's chunk cache by the time they are requested. Only one element
+// per chunk is read, which is enough to load and decode the whole chunk.
+struct Prefetcher {
+    int dimension = 0;
+    int64_t num_chunks = 0;
+    std::vector<int64_t> chunk_shape;  // Read chunk shape, 1 where there is no grid
+    std::vector<int64_t> grid_origin;  // Chunk grid offset of each dimension
+
+    std::mutex mutex;
+    std::vector<int64_t> last_origin;
+    std::vector<int64_t> last_shape;
+    int64_t prefetched_until = 0;  // Exclusive end of the requested read-ahead
+    std::deque<tensorstore::Future<tensorstore::SharedArray<void>>> pending;
+};
+
+// Records a completed read of [origin, origin + shape) and, if it continues a
+// sequential traversal, starts reading the chunks that follow it.
+void NotePrefetchAccess(TSDataset* dataset, const int64_t* origin, const int64_t* shape);
+
+#endif // TENSORSTORE_DLL_PREFETCH_H_
@@ -0,0 +1,384 @@
+#include "handles.h"
+#include "error_handling.h"
+#include "write_back.h"
+
+#include "tensorstore/chunk_layout.h"
+#include "tensorstore/downsample.h"
+#include "tensorstore/downsample_method.h"
+#include "tensorstore/index_space/dim_expression.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/open.h"
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// An OME-Zarr axis. Only "space" axes are downsampled.
+struct Axis {
+    std::string name;
+    std::string type;  // "space", "time", "channel", or empty if unknown
+};
+
+// Without caller-provided axes the trailing (up to three) dimensions are
+// taken as (z, y, x), and up to two leading ones as (c) or (t, c).
+std::vector<Axis> DefaultAxes(tensorstore::DimensionIndex rank) {
+    static const char* const kSpatialAxes[] = {"z", "y", "x"};
+    constexpr tensorstore::DimensionIndex kSpatialDims = 3;
+    const tensorstore::DimensionIndex leading =
+        std::max<tensorstore::DimensionIndex>(rank - kSpatialDims, 0);
+    std::vector<Axis> axes;
+    for (tensorstore::DimensionIndex i = 0; i < leading; ++i) {
+        if (leading <= 2) {
+            const bool time = leading == 2 && i == 0;
+            axes.push_back({time ? "t" : "c", time ? "time" : "channel"});
+        } else {
+            axes.push_back({absl::StrCat("dim_", i), ""});
+        }
+    }
+    for (tensorstore::DimensionIndex i = leading; i < rank; ++i) {
+        axes.push_back({kSpatialAxes[kSpatialDims - (rank - i)], "space"});
+    }
+    return axes;
+}
+
+// Parses one letter per dimension from "tczyx", each used at most once.
+tensorstore::Result<std::vector<Axis>> ParseAxes(const char* letters,
+                                                 tensorstore::DimensionIndex rank) {
+    const std::string text = letters;
+    if (static_cast<tensorstore::DimensionIndex>(text.size()) != rank) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Axes \"", text, "\" do not match rank ", rank));
+    }
+    std::vector<Axis> axes;
+    bool spatial = false;
+    for (char letter : text) {
+        if (text.find(letter) != text.rfind(letter)) {
+            return absl::InvalidArgumentError(absl::StrCat("Repeated axis in \"", text, "\""));
+        }
+        switch (letter) {
+            case 't': axes.push_back({"t", "time"}); break;
+            case 'c': axes.push_back({"c", "channel"}); break;
+            case 'z':
+            case 'y':
+            case 'x':
+                axes.push_back({std::string(1, letter), "space"});
+                spatial = true;
+                break;
+            default:
+                return absl::InvalidArgumentError(
+                    absl::StrCat("Unknown axis '", std::string(1, letter), "' in \"", text,
+                                 "\", expected t, c, z, y or x"));
+        }
+    }
+    if (!spatial) {
+        return absl::InvalidArgumentError(absl::StrCat("No spatial axis in \"", text, "\""));
+    }
+    return axes;
+}
+
+tensorstore::DownsampleMethod ToDownsampleMethod(TSDownsampleMethod method) {
+    switch (method) {
+        case TS_DOWNSAMPLE_MODE:   return tensorstore::DownsampleMethod::kMode;
+        case TS_DOWNSAMPLE_STRIDE: return tensorstore::DownsampleMethod::kStride;
+        case TS_DOWNSAMPLE_MEAN:
+        default:                   return tensorstore::DownsampleMethod::kMean;
+    }
+}
+
+// Name of pyramid level `level` next to a base array called `base`. The
+// OME-Zarr convention of numbered arrays ("0", "1", ...) is continued when
+// the base name is a number.
+std::string LevelName(const std::string& base, int level) {
+    if (!base.empty() && std::all_of(base.begin(), base.end(), absl::ascii_isdigit)) {
+        return std::to_string(std::stoll(base) + level);
+    }
+    return absl::StrCat(base, "_", level);
+}
+
+// Copies `source` into `target` one target write chunk at a time, with at
+// most `max_in_flight` chunks being read, downsampled and written at once.
+// This bounds memory independent of the volume size while keeping the data
+// copy executor busy.
+absl::Status CopyByChunk(const tensorstore::TensorStore<>& source,
+                         const tensorstore::TensorStore<>& target, size_t max_in_flight) {
+    auto layout = target.chunk_layout();
+    if (!layout.ok()) {
+        return layout.status();
+    }
+    const tensorstore::DimensionIndex rank = target.rank();
+    auto domain = target.domain();
+    std::vector<tensorstore::Index> chunk(rank);
+    for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+        const tensorstore::Index extent = layout->write_chunk_shape()[i];
+        chunk[i] = extent > 0 ? extent : std::max<tensorstore::Index>(domain[i].size(), 1);
+    }
+
+    std::deque<tensorstore::Future<void>> pending;
+    absl::Status status;
+    auto wait_oldest = [&]() {
+        const absl::Status& result = pending.front().status();
+        if (!result.ok() && status.ok()) status = result;
+        pending.pop_front();
+    };
+
+    std::vector<tensorstore::Index> cell(rank, 0);
+    std::vector<tensorstore::Index> origin(rank);
+    std::vector<tensorstore::Index> shape(rank);
+    for (bool done = false; !done && status.ok();) {
+        for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+            origin[i] = domain[i].inclusive_min() + cell[i] * chunk[i];
+            shape[i] = std::min(chunk[i], domain[i].exclusive_max() - origin[i]);
+        }
+        auto interval = tensorstore::AllDims().SizedInterval(origin, shape);
+        auto source_cell = source | interval;
+        auto target_cell = target | interval;
+        if (!source_cell.ok()) return source_cell.status();
+        if (!target_cell.ok()) return target_cell.status();
+        pending.push_back(tensorstore::Copy(*source_cell, *target_cell).commit_future);
+        while (pending.size() >= max_in_flight) wait_oldest();
+
+        // Advance to the next chunk, last dimension fastest.
+        tensorstore::DimensionIndex d = rank - 1;
+        for (; d >= 0; --d) {
+            if (domain[d].inclusive_min() + ++cell[d] * chunk[d] < domain[d].exclusive_max()) {
+                break;
+            }
+            cell[d] = 0;
+        }
+        done = d < 0;
+    }
+    while (!pending.empty()) wait_oldest();
+    return status;
+}
+
+// Spec for a new level array: the base array's metadata (codecs, chunking,
+// sharding) with a new shape, stored under `path`.
+tensorstore::Result<::nlohmann::json> LevelSpec(const tensorstore::TensorStore<>& base,
+                                                const std::vector<tensorstore::Index>& shape,
+                                                const std::string& path) {
+    auto spec = base.spec();
+    if (!spec.ok()) {
+        return spec.status();
+    }
+    auto json = spec->ToJson();
+    if (!json.ok()) {
+        return json.status();
+    }
+    ::nlohmann::json metadata = (*json)["metadata"];
+    metadata["shape"] = shape;
+    metadata.erase("attributes");
+    return ::nlohmann::json{
+        {"driver", (*json)["driver"]},
+        {"kvstore", {{"driver", "file"}, {"path", absl::StrCat(path, "/")}}},
+        {"metadata", std::move(metadata)},
+    };
+}
+
+::nlohmann::json MultiscalesJson(const std::vector<std::string>& names,
+                                 const std::vector<Axis>& axes, TSDownsampleMethod method) {
+    ::nlohmann::json axes_json = ::nlohmann::json::array();
+    for (const Axis& axis : axes) {
+        ::nlohmann::json entry = {{"name", axis.name}};
+        if (!axis.type.empty()) entry["type"] = axis.type;
+        axes_json.push_back(std::move(entry));
+    }
+
+    ::nlohmann::json datasets = ::nlohmann::json::array();
+    for (size_t level = 0; level < names.size(); ++level) {
+        std::vector<double> scale(axes.size(), 1.0);
+        for (size_t i = 0; i < axes.size(); ++i) {
+            if (axes[i].type == "space") scale[i] = static_cast<double>(int64_t{1} << level);
+        }
+        datasets.push_back({
+            {"path", names[level]},
+            {"coordinateTransformations",
+             ::nlohmann::json::array({{{"type", "scale"}, {"scale", scale}}})},
+        });
+    }
+    static const char* const kMethodNames[] = {"mean", "mode", "stride"};
+    return {
+        {"axes", axes_json},
+        {"datasets", datasets},
+        {"type", kMethodNames[method]},
+    };
+}
+
+// Records the pyramid in the parent group's attributes: "multiscales" in
+// .zattrs (OME-Zarr 0.4) for zarr v2, "ome.multiscales" in zarr.json
+// (OME-Zarr 0.5) for zarr v3. Other attributes are preserved.
+absl::Status WriteMultiscales(TSDataset* dataset, const std::string& parent,
+                              ::nlohmann::json multiscales) {
+    tensorstore::KvStore group = dataset->kvstore;
+    group.path = absl::StrCat(parent, "/");
+    const bool v3 = dataset->zarr_format == 3;
+    const char* key = v3 ? "zarr.json" : ".zattrs";
+
+    auto read = tensorstore::kvstore::Read(group, key).result();
+    if (!read.ok()) {
+        return read.status();
+    }
+    ::nlohmann::json file = ::nlohmann::json::object();
+    if (read->has_value()) {
+        file = ::nlohmann::json::parse(std::string(read->value), nullptr,
+                                       /*allow_exceptions=*/false);
+        if (file.is_discarded() || !file.is_object()) {
+            return absl::DataLossError(absl::StrCat("Invalid JSON object in group ", key));
+        }
+    }
+    if (v3) {
+        file["zarr_format"] = 3;
+        file["node_type"] = "group";
+        file["attributes"]["ome"] = {
+            {"version", "0.5"},
+            {"multiscales", ::nlohmann::json::array({std::move(multiscales)})},
+        };
+    } else {
+        multiscales["version"] = "0.4";
+        file["multiscales"] = ::nlohmann::json::array({std::move(multiscales)});
+        auto zgroup = tensorstore::kvstore::Write(group, ".zgroup",
+                                                  absl::Cord(R"({"zarr_format":2})"))
+                          .result();
+        if (!zgroup.ok()) {
+            return zgroup.status();
+        }
+    }
+    return tensorstore::kvstore::Write(group, key, absl::Cord(file.dump())).status();
+}
+
+absl::Status BuildPyramid(TSDataset* dataset, int levels, TSDownsampleMethod method,
+                          const std::vector<Axis>& axes) {
+    // The base array's directory holds the levels and becomes the image
+    // group. A bare relative name has no such directory of its own, and
+    // would turn the working directory into the group.
+    const std::filesystem::path given = std::filesystem::path(dataset->path).lexically_normal();
+    std::filesystem::path base_dir = given;
+    if (!base_dir.has_filename()) base_dir = base_dir.parent_path();
+    if (!base_dir.has_parent_path()) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "Pyramid base ", dataset->path,
+            " must be inside a group directory, e.g. image.zarr/0"));
+    }
+    base_dir = std::filesystem::absolute(base_dir).lexically_normal();
+    const std::string base_name = base_dir.filename().string();
+    const std::string parent = base_dir.parent_path().generic_string();
+
+    // Level 0 is read from storage, so writes staged in the write-back
+    // cache are committed first.
+    auto flushed = FlushWriteBack(dataset);
+    if (!flushed.ok()) {
+        return flushed;
+    }
+
+    const tensorstore::DimensionIndex rank = dataset->store.rank();
+    std::vector<tensorstore::Index> factors(rank, 1);
+    for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+        if (axes[i].type == "space") factors[i] = 2;
+    }
+    const size_t max_in_flight =
+        std::max<size_t>(4, 2 * std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<std::string> names = {base_name};
+    tensorstore::TensorStore<> source = dataset->store;
+    for (int level = 1; level <= levels; ++level) {
+        // Each level is computed from the previous one, already on disk,
+        // rather than from the full-resolution array.
+        auto downsampled = tensorstore::Downsample(source, factors, ToDownsampleMethod(method));
+        if (!downsampled.ok()) {
+            return downsampled.status();
+        }
+        auto shape = downsampled->domain().shape();
+        const std::vector<tensorstore::Index> level_shape(shape.begin(), shape.end());
+
+        const std::string name = LevelName(base_name, level);
+        auto spec = LevelSpec(dataset->store, level_shape, absl::StrCat(parent, "/", name));
+        if (!spec.ok()) {
+            return spec.status();
+        }
+        auto target = tensorstore::Open(*spec, dataset->context,
+                                        tensorstore::OpenMode::create |
+                                            tensorstore::OpenMode::delete_existing,
+                                        tensorstore::ReadWriteMode::read_write)
+                          .result();
+        if (!target.ok()) {
+            return target.status();
+        }
+        auto status = CopyByChunk(*downsampled, *target, max_in_flight);
+        if (!status.ok()) {
+            return status;
+        }
+        names.push_back(name);
+        source = *std::move(target);
+    }
+    return WriteMultiscales(dataset, parent, MultiscalesJson(names, axes, method));
+}
+
+bool CheckPyramidArgs(TSDataset* dataset, int levels, TSDownsampleMethod method,
+                      TSError* error) {
+    if (!dataset || levels < 1 ||
+        (method != TS_DOWNSAMPLE_MEAN && method != TS_DOWNSAMPLE_MODE &&
+         method != TS_DOWNSAMPLE_STRIDE)) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+extern "C" {
+
+int TSBuildPyramid(TSDataset* dataset, int levels, TSDownsampleMethod method, TSError* error) {
+    if (!CheckPyramidArgs(dataset, levels, method, error)) {
+        return -1;
+    }
+    try {
+        auto status = BuildPyramid(dataset, levels, method, DefaultAxes(dataset->store.rank()));
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSBuildPyramidWithAxes(TSDataset* dataset, int levels, TSDownsampleMethod method,
+                           const char* axes, TSError* error) {
+    if (!CheckPyramidArgs(dataset, levels, method, error)) {
+        return -1;
+    }
+    if (!axes) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        auto parsed = ParseAxes(axes, dataset->store.rank());
+        if (!parsed.ok()) {
+            SetError(error, parsed.status());
+            return -1;
+        }
+        auto status = BuildPyramid(dataset, levels, method, *parsed);
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+} // extern "C"
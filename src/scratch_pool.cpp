@@ -0,0 +1,147 @@
+#include "scratch_pool.h"
+
+#include <functional>
+#include <new>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <cstdlib>
+#endif
+
+namespace {
+
+char* AlignedAlloc(size_t size) {
+#ifdef _WIN32
+    void* data = _aligned_malloc(size, ScratchPool::kAlignment);
+#else
+    void* data = std::aligned_alloc(ScratchPool::kAlignment, size);
+#endif
+    if (!data) {
+        throw std::bad_alloc();
+    }
+    return static_cast<char*>(data);
+}
+
+void AlignedFree(char* data) {
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    std::free(data);
+#endif
+}
+
+} // namespace
+
+ScratchPool::Buffer::Buffer(Buffer&& other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr)),
+      data_(std::exchange(other.data_, nullptr)),
+      capacity_(std::exchange(other.capacity_, 0)),
+      shard_(other.shard_) {}
+
+ScratchPool::Buffer& ScratchPool::Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        if (data_) pool_->Release(*this);
+        pool_ = std::exchange(other.pool_, nullptr);
+        data_ = std::exchange(other.data_, nullptr);
+        capacity_ = std::exchange(other.capacity_, 0);
+        shard_ = other.shard_;
+    }
+    return *this;
+}
+
+ScratchPool::Buffer::~Buffer() {
+    if (data_) pool_->Release(*this);
+}
+
+void ScratchPool::Buffer::Leak() {
+    pool_ = nullptr;
+    data_ = nullptr;
+    capacity_ = 0;
+}
+
+ScratchPool::~ScratchPool() {
+    for (Shard& shard : shards_) {
+        for (auto& list : shard.free) {
+            for (char* data : list) AlignedFree(data);
+        }
+    }
+}
+
+int ScratchPool::ThreadShard() {
+    return static_cast<int>(std::hash<std::thread::id>()(std::this_thread::get_id()) %
+                            kNumShards);
+}
+
+int ScratchPool::SizeClass(size_t size) {
+    int size_class = 0;
+    for (size_t capacity = kMinClassBytes; capacity < size && size_class < kNumClasses;
+         capacity <<= 1) {
+        ++size_class;
+    }
+    return size_class;
+}
+
+ScratchPool::Buffer ScratchPool::Acquire(size_t size) {
+    Buffer buffer;
+    buffer.pool_ = this;
+    buffer.shard_ = ThreadShard();
+    const int size_class = SizeClass(size);
+    if (size_class == kNumClasses) {
+        // Too large to pool; rounded to the alignment only.
+        buffer.capacity_ = (size + kAlignment - 1) / kAlignment * kAlignment;
+        buffer.data_ = AlignedAlloc(buffer.capacity_);
+        allocated_.fetch_add(1, std::memory_order_relaxed);
+        return buffer;
+    }
+    buffer.capacity_ = kMinClassBytes << size_class;
+    {
+        Shard& shard = shards_[buffer.shard_];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto& list = shard.free[size_class];
+        if (!list.empty()) {
+            buffer.data_ = list.back();
+            list.pop_back();
+            cached_bytes_.fetch_sub(buffer.capacity_, std::memory_order_relaxed);
+            reused_.fetch_add(1, std::memory_order_relaxed);
+            return buffer;
+        }
+    }
+    buffer.data_ = AlignedAlloc(buffer.capacity_);
+    allocated_.fetch_add(1, std::memory_order_relaxed);
+    return buffer;
+}
+
+std::shared_ptr<void> ScratchPool::AcquireShared(size_t size) {
+    // The owner keeps the pool alive until the buffer has been returned.
+    auto owner = std::make_shared<std::pair<std::shared_ptr<ScratchPool>, Buffer>>(
+        shared_from_this(), Acquire(size));
+    char* data = owner->second.data();
+    return std::shared_ptr<void>(std::move(owner), data);
+}
+
+void ScratchPool::Release(const Buffer& buffer) {
+    char* data = buffer.data_;
+    const size_t capacity = buffer.capacity_;
+    const int size_class = SizeClass(capacity);
+    const bool pooled = size_class < kNumClasses && (kMinClassBytes << size_class) == capacity;
+    if (!pooled || cached_bytes_.fetch_add(capacity, std::memory_order_relaxed) + capacity >
+                       kMaxCachedBytes) {
+        if (pooled) cached_bytes_.fetch_sub(capacity, std::memory_order_relaxed);
+        AlignedFree(data);
+        return;
+    }
+    Shard& shard = shards_[buffer.shard_];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.free[size_class].push_back(data);
+}
+
+::nlohmann::json ScratchPool::ToJson() const {
+    return {
+        {"allocated", allocated_.load(std::memory_order_relaxed)},
+        {"reused", reused_.load(std::memory_order_relaxed)},
+        {"cached_bytes", cached_bytes_.load(std::memory_order_relaxed)},
+    };
+}
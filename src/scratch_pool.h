@@ -0,0 +1,84 @@
+#ifndef TENSORSTORE_DLL_SCRATCH_POOL_H_
+#define TENSORSTORE_DLL_SCRATCH_POOL_H_
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Page-aligned scratch buffers recycled by power-of-two size class. A pool is
+// owned by a context and shared with its datasets. Free buffers are cached in
+// shards picked by the acquiring thread, so threads rarely contend, up to a
+// total of kMaxCachedBytes per pool. A buffer returns to the shard it came
+// from, even when tensorstore drops it on one of its own threads.
+class ScratchPool : public std::enable_shared_from_this<ScratchPool> {
+public:
+    static constexpr size_t kAlignment = 4096;
+
+    // Buffer that goes back to its pool when destroyed.
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+        ~Buffer();
+
+        char* data() const { return data_; }
+        size_t capacity() const { return capacity_; }
+
+        // Gives up the memory without returning it to the pool or freeing it,
+        // for buffers something else may still write to.
+        void Leak();
+
+    private:
+        friend class ScratchPool;
+
+        ScratchPool* pool_ = nullptr;
+        char* data_ = nullptr;
+        size_t capacity_ = 0;
+        int shard_ = 0;
+    };
+
+    ScratchPool() = default;
+    ~ScratchPool();
+    ScratchPool(const ScratchPool&) = delete;
+    ScratchPool& operator=(const ScratchPool&) = delete;
+
+    // Returns a buffer of at least `size` bytes. Contents are uninitialised.
+    Buffer Acquire(size_t size);
+
+    // Like Acquire, for memory handed to tensorstore: the buffer returns to
+    // the pool when the last reference is dropped, which may be after the
+    // context is destroyed.
+    std::shared_ptr<void> AcquireShared(size_t size);
+
+    // Allocation counters, reported by TSGetMetrics.
+    ::nlohmann::json ToJson() const;
+
+private:
+    static constexpr size_t kMinClassBytes = kAlignment;
+    static constexpr int kNumClasses = 17;        // 4 KiB to 256 MiB
+    static constexpr int kNumShards = 8;
+    static constexpr size_t kMaxCachedBytes = size_t{256} << 20;
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<char*> free[kNumClasses];
+    };
+
+    // Smallest class holding `size` bytes, or kNumClasses if there is none.
+    static int SizeClass(size_t size);
+    void Release(const Buffer& buffer);
+    static int ThreadShard();
+
+    Shard shards_[kNumShards];
+    std::atomic<size_t> cached_bytes_{0};
+    std::atomic<int64_t> allocated_{0};  // Acquires served by a new allocation
+    std::atomic<int64_t> reused_{0};     // Acquires served from the cache
+};
+
+#endif // TENSORSTORE_DLL_SCRATCH_POOL_H_
@@ -0,0 +1,223 @@
+#include "handles.h"
+#include "error_handling.h"
+
+#include "tensorstore/array.h"
+#include "tensorstore/chunk_layout.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+struct TSStreamWriter {
+    TSDataset* dataset = nullptr;
+    tensorstore::DataType dtype;
+    std::vector<tensorstore::Index> frame_shape;  // Shape of one frame (dims 1..rank-1)
+    size_t frame_bytes = 0;
+    int64_t chunk_depth = 1;   // Write chunk extent along dimension 0
+    int64_t start_frame = 0;
+    int64_t frame_limit = 0;   // Exclusive upper bound along dimension 0
+    int64_t next_frame = 0;
+    int64_t slab_start = 0;
+    int64_t slab_end = 0;
+    size_t max_pending = 2;
+    tensorstore::SharedArray<void> slab;
+    std::deque<tensorstore::Future<void>> pending;
+    absl::Status status;       // First background write failure, if any
+};
+
+namespace {
+
+void WaitOldest(TSStreamWriter* writer) {
+    tensorstore::Future<void> future = std::move(writer->pending.front());
+    writer->pending.pop_front();
+    const absl::Status& status = future.status();
+    if (!status.ok() && writer->status.ok()) {
+        writer->status = status;
+    }
+}
+
+// Drops writes that have already completed without blocking.
+void ReapCompleted(TSStreamWriter* writer) {
+    while (!writer->pending.empty() && writer->pending.front().ready()) {
+        WaitOldest(writer);
+    }
+}
+
+// Starts a slab at the next frame that ends on the following chunk boundary,
+// so every full slab maps to whole write chunks.
+void StartSlab(TSStreamWriter* writer) {
+    writer->slab_start = writer->next_frame;
+    writer->slab_end = std::min((writer->slab_start / writer->chunk_depth + 1) * writer->chunk_depth,
+                                writer->frame_limit);
+
+    std::vector<tensorstore::Index> slab_shape;
+    slab_shape.push_back(writer->slab_end - writer->slab_start);
+    slab_shape.insert(slab_shape.end(), writer->frame_shape.begin(), writer->frame_shape.end());
+    // Slab memory comes from the context's scratch pool and returns to it
+    // once tensorstore has consumed the write.
+    size_t bytes = writer->dtype.size();
+    for (tensorstore::Index extent : slab_shape) bytes *= static_cast<size_t>(extent);
+    writer->slab = tensorstore::SharedArray<void>(
+        tensorstore::SharedElementPointer<void>(writer->dataset->scratch->AcquireShared(bytes),
+                                                writer->dtype),
+        tensorstore::StridedLayout<>(tensorstore::c_order, writer->dtype.size(), slab_shape));
+}
+
+// Hands the filled part of the current slab to tensorstore. The array owns its
+// buffer, so it stays alive until the write has consumed it.
+absl::Status SubmitSlab(TSStreamWriter* writer) {
+    const int64_t filled = writer->next_frame - writer->slab_start;
+
+    std::vector<tensorstore::Index> origin(writer->frame_shape.size() + 1, 0);
+    std::vector<tensorstore::Index> shape;
+    origin[0] = writer->slab_start;
+    shape.push_back(filled);
+    shape.insert(shape.end(), writer->frame_shape.begin(), writer->frame_shape.end());
+
+    tensorstore::SharedArray<void> source(
+        writer->slab.element_pointer(),
+        tensorstore::StridedLayout<>(tensorstore::c_order, writer->dtype.size(), shape));
+    writer->slab = tensorstore::SharedArray<void>();
+
+    auto region = GetRegion(writer->dataset, origin.data(), shape.data());
+    if (!region.ok()) {
+        return region.status();
+    }
+    auto future = tensorstore::Write(std::move(source), *region).commit_future;
+    TrackOperation(writer->dataset->metrics, ContextMetrics::kWrite,
+                   RegionBytes(writer->dataset, shape.data()), future);
+    writer->pending.push_back(std::move(future));
+
+    ReapCompleted(writer);
+    while (writer->pending.size() >= writer->max_pending) {
+        WaitOldest(writer);
+    }
+    return writer->status;
+}
+
+} // namespace
+
+extern "C" {
+
+TSStreamWriter* TSCreateStreamWriter(TSDataset* dataset, int64_t start_frame,
+                                     int max_pending_chunks, TSError* error) {
+    if (!dataset || dataset->store.rank() < 1) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return nullptr;
+    }
+    try {
+        auto domain = dataset->store.domain();
+        if (start_frame < domain[0].inclusive_min() || start_frame > domain[0].exclusive_max()) {
+            SetError(error, absl::OutOfRangeError(absl::StrCat(
+                                "Start frame ", start_frame, " is outside [",
+                                domain[0].inclusive_min(), ", ", domain[0].exclusive_max(), ")")));
+            return nullptr;
+        }
+        auto layout = dataset->store.chunk_layout();
+        if (!layout.ok()) {
+            SetError(error, layout.status());
+            return nullptr;
+        }
+
+        auto writer = new TSStreamWriter;
+        writer->dataset = dataset;
+        writer->dtype = ToTensorstoreDataType(dataset->dtype);
+        writer->frame_shape.assign(domain.shape().begin() + 1, domain.shape().end());
+        writer->frame_bytes = writer->dtype.size();
+        for (tensorstore::Index extent : writer->frame_shape) {
+            writer->frame_bytes *= static_cast<size_t>(extent);
+        }
+        const tensorstore::Index depth = layout->write_chunk_shape()[0];
+        writer->chunk_depth = depth > 0 ? depth : 1;
+        writer->start_frame = start_frame;
+        writer->frame_limit = domain[0].exclusive_max();
+        writer->next_frame = start_frame;
+        writer->max_pending = max_pending_chunks > 0 ? static_cast<size_t>(max_pending_chunks) : 2;
+        return writer;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return nullptr;
+    }
+}
+
+int TSStreamWriterAppend(TSStreamWriter* writer, const void* frame, TSError* error) {
+    if (!writer || !frame) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    if (!writer->status.ok()) {
+        SetError(error, writer->status);
+        return -1;
+    }
+    if (writer->next_frame >= writer->frame_limit) {
+        SetError(error, absl::OutOfRangeError(absl::StrCat(
+                            "Frame ", writer->next_frame, " exceeds dataset extent ",
+                            writer->frame_limit)));
+        return -1;
+    }
+    try {
+        if (!writer->slab.valid()) {
+            StartSlab(writer);
+        }
+        char* dest = static_cast<char*>(writer->slab.data()) +
+                     (writer->next_frame - writer->slab_start) * writer->frame_bytes;
+        std::memcpy(dest, frame, writer->frame_bytes);
+        ++writer->next_frame;
+
+        if (writer->next_frame == writer->slab_end) {
+            auto status = SubmitSlab(writer);
+            if (!status.ok()) {
+                SetError(error, status);
+                return -1;
+            }
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSStreamWriterFlush(TSStreamWriter* writer, TSError* error) {
+    if (!writer) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        if (writer->slab.valid() && writer->next_frame > writer->slab_start) {
+            auto status = SubmitSlab(writer);
+            if (!status.ok() && writer->status.ok()) {
+                writer->status = status;
+            }
+        }
+        while (!writer->pending.empty()) {
+            WaitOldest(writer);
+        }
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+    if (!writer->status.ok()) {
+        SetError(error, writer->status);
+        return -1;
+    }
+    return 0;
+}
+
+int64_t TSStreamWriterGetFrameCount(TSStreamWriter* writer) {
+    return writer ? writer->next_frame - writer->start_frame : 0;
+}
+
+int TSDestroyStreamWriter(TSStreamWriter* writer, TSError* error) {
+    if (!writer) {
+        return 0;
+    }
+    int result = TSStreamWriterFlush(writer, error);
+    delete writer;
+    return result;
+}
+
+} // extern "C"
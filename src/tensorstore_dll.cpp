@@ -1,17 +1,508 @@
-
 #include "tensorstore_dll/span_fix.h"  // Must come first
 #include "tensorstore_dll/tensorstore_dll.h"
 #include "tensorstore_dll/version.h"
 #include "error_handling.h"
+#include "handles.h"
+#include "convert_kernels.h"
+#include "uring_reader.h"
+#include "write_back.h"
+#include "zarr_spec.h"
 
 #include "tensorstore/context.h"
 #include "tensorstore/driver/zarr/driver.h"
+#include "tensorstore/driver/zarr3/driver.h"
+#include "tensorstore/array.h"
+#include "tensorstore/batch.h"
+#include "tensorstore/cast.h"
+#include "tensorstore/chunk_layout.h"
+#include "tensorstore/index_space/dim_expression.h"
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/open.h"
+#include "tensorstore/tensorstore.h"
+#include "tensorstore/util/executor.h"
+#include "tensorstore/util/future.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+tensorstore::Result<tensorstore::TensorStore<>> GetRegion(
+        TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+        const tensorstore::Transaction& transaction) {
+    const tensorstore::DimensionIndex rank = dataset->store.rank();
+    auto store = dataset->store | transaction;
+    if (!store.ok()) {
+        return store.status();
+    }
+    return *store |
+           tensorstore::AllDims().TranslateSizedInterval(
+               tensorstore::span<const tensorstore::Index>(origin, rank),
+               tensorstore::span<const tensorstore::Index>(shape, rank));
+}
+
+int64_t RegionBytes(TSDataset* dataset, const int64_t* shape) {
+    int64_t bytes = ToTensorstoreDataType(dataset->dtype).size();
+    for (tensorstore::DimensionIndex i = 0; i < dataset->store.rank(); ++i) {
+        bytes *= shape[i];
+    }
+    return bytes;
+}
+
+namespace {
+
+// Wraps a caller-owned buffer of `dtype` elements without taking ownership.
+// The buffer is C-order unless `byte_strides` (one entry per dimension) is
+// given.
+template <typename Element>
+tensorstore::SharedArray<Element> WrapBuffer(tensorstore::DataType dtype,
+                                             tensorstore::DimensionIndex rank, Element* data,
+                                             const int64_t* shape,
+                                             const int64_t* byte_strides) {
+    auto pointer = tensorstore::UnownedToShared(tensorstore::ElementPointer<Element>(data, dtype));
+    tensorstore::span<const tensorstore::Index> extents(shape, rank);
+    if (byte_strides) {
+        return tensorstore::SharedArray<Element>(
+            pointer, tensorstore::StridedLayout<>(
+                         extents, tensorstore::span<const tensorstore::Index>(byte_strides, rank)));
+    }
+    return tensorstore::SharedArray<Element>(
+        pointer, tensorstore::StridedLayout<>(tensorstore::c_order, dtype.size(), extents));
+}
+
+// Wraps a caller-owned buffer of the dataset's element type.
+template <typename Element>
+tensorstore::SharedArray<Element> WrapBuffer(TSDataset* dataset, Element* data,
+                                             const int64_t* shape,
+                                             const int64_t* byte_strides) {
+    return WrapBuffer(ToTensorstoreDataType(dataset->dtype), dataset->store.rank(), data, shape,
+                      byte_strides);
+}
 
-struct TSContext {
-    tensorstore::Context ctx;
-};
+bool CheckRegionArgs(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                     const void* data, TSError* error) {
+    if (!dataset || !origin || !shape || !data) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return false;
+    }
+    // Checked here rather than left to tensorstore so that the common
+    // out-of-bounds failure does not build a Status message.
+    const auto domain = dataset->store.domain();
+    for (tensorstore::DimensionIndex i = 0; i < domain.rank(); ++i) {
+        const tensorstore::IndexInterval bounds = domain[i].interval();
+        if (shape[i] < 0 || origin[i] < bounds.inclusive_min() ||
+            origin[i] > bounds.exclusive_max() || shape[i] > bounds.exclusive_max() - origin[i]) {
+            SetErrorFormat(error, absl::StatusCode::kOutOfRange,
+                           "Region [%lld, %lld) of dimension %lld is outside [%lld, %lld)",
+                           {origin[i], origin[i] + shape[i], i, bounds.inclusive_min(),
+                            bounds.exclusive_max()});
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CheckDataType(TSDataset* dataset, TSDataType expected, TSError* error) {
+    if (dataset->dtype != expected) {
+        SetError(error, absl::InvalidArgumentError(absl::StrCat(
+                            "Dataset data type ", static_cast<int>(dataset->dtype),
+                            " does not match requested type ", static_cast<int>(expected))));
+        return false;
+    }
+    return true;
+}
+
+tensorstore::Future<void> StartRead(TSDataset* dataset, const int64_t* origin,
+                                    const int64_t* shape, void* data,
+                                    const int64_t* byte_strides = nullptr,
+                                    tensorstore::Batch::View batch = tensorstore::no_batch) {
+    // Bound to the write-back transaction, if any, so staged writes are visible.
+    auto future = ReadWithWriteBack(
+        dataset, [&](const tensorstore::Transaction& transaction) -> tensorstore::Future<void> {
+            auto region = GetRegion(dataset, origin, shape, transaction);
+            if (!region.ok()) {
+                return tensorstore::MakeReadyFuture<void>(region.status());
+            }
+            return tensorstore::Read(*region, WrapBuffer(dataset, data, shape, byte_strides),
+                                     batch);
+        });
+    TrackOperation(dataset->metrics, ContextMetrics::kRead, RegionBytes(dataset, shape), future);
+    return future;
+}
+
+// Blocking reads of uncompressed datasets are copied straight out of the
+// mapped chunk files, skipping the kvstore read and the chunk cache. Regions
+// with missing chunks, which read as the fill value, and staged write-back
+// data go through tensorstore.
+absl::Status ReadRegion(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                        void* data, const int64_t* byte_strides, bool* mapped) {
+    *mapped = false;
+    if (!dataset->mapped_chunks || dataset->write_back) {
+        return StartRead(dataset, origin, shape, data, byte_strides).status();
+    }
+    // Tracked through a promise so the metrics include the copy's latency.
+    auto pair = tensorstore::PromiseFuturePair<void>::Make();
+    TrackOperation(dataset->metrics, ContextMetrics::kRead, RegionBytes(dataset, shape),
+                   pair.future);
+    absl::Status status;
+    auto result = ReadMapped(dataset, origin, shape, data, byte_strides);
+    if (!result.ok() || *result) {
+        status = result.status();
+        *mapped = status.ok();
+    } else {
+        auto region = GetRegion(dataset, origin, shape);
+        status = region.ok() ? tensorstore::Read(*region, WrapBuffer(dataset, data, shape,
+                                                                     byte_strides))
+                                   .status()
+                             : region.status();
+    }
+    pair.promise.SetResult(tensorstore::MakeResult(status));
+    return status;
+}
+
+// Writes of at least this many bytes are split along the write chunk grid.
+constexpr int64_t kPartitionedWriteBytes = int64_t{16} << 20;
+
+tensorstore::Future<void> WriteRegion(TSDataset* dataset, const int64_t* origin,
+                                      const int64_t* shape, const void* data,
+                                      const int64_t* byte_strides) {
+    auto region = GetRegion(dataset, origin, shape);
+    if (!region.ok()) {
+        return tensorstore::MakeReadyFuture<void>(region.status());
+    }
+    return tensorstore::Write(WrapBuffer(dataset, data, shape, byte_strides), *region)
+        .commit_future;
+}
+
+// Stages a write in the write-back transaction. The returned future completes
+// once the data has been copied into the transaction's chunk cache; storage is
+// only written when the transaction is committed.
+tensorstore::Future<void> StageWrite(TSDataset* dataset, const int64_t* origin,
+                                     const int64_t* shape, const void* data,
+                                     const int64_t* byte_strides) {
+    return StageWriteBack(
+        dataset, origin, shape,
+        [&](const tensorstore::Transaction& transaction) -> tensorstore::Future<void> {
+            auto region = GetRegion(dataset, origin, shape, transaction);
+            if (!region.ok()) {
+                return tensorstore::MakeReadyFuture<void>(region.status());
+            }
+            return tensorstore::Write(WrapBuffer(dataset, data, shape, byte_strides), *region)
+                .copy_future;
+        });
+}
+
+// Large writes are issued as one independent write per slab of write chunks
+// along dimension 0. Each slab commits on its own as soon as it has been
+// copied, so chunk encoding on the context's data copy executor overlaps
+// with the file writes of earlier slabs instead of waiting for the whole
+// region. Slabs are chunk aligned, so no two of them touch the same chunk.
+tensorstore::Future<void> StartWrite(TSDataset* dataset, const int64_t* origin,
+                                     const int64_t* shape, const void* data,
+                                     const int64_t* byte_strides = nullptr) {
+    const int64_t bytes = RegionBytes(dataset, shape);
+    if (dataset->write_back) {
+        auto future = StageWrite(dataset, origin, shape, data, byte_strides);
+        TrackOperation(dataset->metrics, ContextMetrics::kWrite, bytes, future);
+        return future;
+    }
+    if (IsWholeWriteChunks(dataset, origin, shape)) {
+        auto future = StartWriteDirect(dataset, origin, shape,
+                                       WrapBuffer(dataset, data, shape, byte_strides));
+        TrackOperation(dataset->metrics, ContextMetrics::kWrite, bytes, future);
+        return future;
+    }
+    int64_t depth = 0;
+    int64_t grid_origin = 0;
+    if (bytes >= kPartitionedWriteBytes) {
+        auto layout = dataset->store.chunk_layout();
+        if (layout.ok()) {
+            depth = layout->write_chunk_shape()[0];
+            if (layout->grid_origin()[0] != tensorstore::kImplicit) {
+                grid_origin = layout->grid_origin()[0];
+            }
+        }
+    }
+    if (depth <= 0 || shape[0] <= depth) {
+        auto future = WriteRegion(dataset, origin, shape, data, byte_strides);
+        TrackOperation(dataset->metrics, ContextMetrics::kWrite, bytes, future);
+        return future;
+    }
+
+    const tensorstore::DimensionIndex rank = dataset->store.rank();
+    const int64_t plane_stride = byte_strides ? byte_strides[0] : bytes / shape[0];
+    std::vector<int64_t> slab_origin(origin, origin + rank);
+    std::vector<int64_t> slab_shape(shape, shape + rank);
+
+    // The slabs all copy from the caller's buffer, so the combined future
+    // waits for every one of them, even after a failure, and then reports the
+    // first slab error.
+    std::vector<tensorstore::AnyFuture> slabs;
+    const int64_t end = origin[0] + shape[0];
+    for (int64_t start = origin[0]; start < end;) {
+        const int64_t stop =
+            std::min(grid_origin + ((start - grid_origin) / depth + 1) * depth, end);
+        slab_origin[0] = start;
+        slab_shape[0] = stop - start;
+        const char* slab_data =
+            static_cast<const char*>(data) + (start - origin[0]) * plane_stride;
+        slabs.push_back(WriteRegion(dataset, slab_origin.data(), slab_shape.data(), slab_data,
+                                    byte_strides));
+        start = stop;
+    }
+    auto all = tensorstore::WaitAllFuture(slabs);
+    auto future = tensorstore::MapFuture(
+        tensorstore::InlineExecutor{},
+        [slabs = std::move(slabs)](const tensorstore::Result<void>&) {
+            absl::Status status;
+            for (const auto& slab : slabs) {
+                status.Update(slab.status());
+            }
+            return tensorstore::MakeResult(status);
+        },
+        std::move(all));
+    TrackOperation(dataset->metrics, ContextMetrics::kWrite, bytes, future);
+    return future;
+}
+
+// Calls `func(block_origin, block_shape)` for each piece of [origin, origin +
+// shape) cut along the read chunk grid, in C order. Dimensions without a
+// regular grid are not split.
+template <typename Func>
+void ForEachReadChunkBlock(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                           Func func) {
+    const tensorstore::DimensionIndex rank = dataset->store.rank();
+    std::vector<int64_t> chunk(rank, 0);
+    std::vector<int64_t> grid_origin(rank, 0);
+    auto layout = dataset->store.chunk_layout();
+    if (layout.ok()) {
+        for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+            chunk[i] = layout->read_chunk_shape()[i];
+            if (layout->grid_origin()[i] != tensorstore::kImplicit) {
+                grid_origin[i] = layout->grid_origin()[i];
+            }
+        }
+    }
+    for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+        if (shape[i] <= 0) {
+            return;
+        }
+    }
+    auto block_end = [&](tensorstore::DimensionIndex i, int64_t start) {
+        const int64_t end = origin[i] + shape[i];
+        if (chunk[i] <= 0) {
+            return end;
+        }
+        return std::min(grid_origin[i] + ((start - grid_origin[i]) / chunk[i] + 1) * chunk[i],
+                        end);
+    };
+    std::vector<int64_t> block_origin(origin, origin + rank);
+    std::vector<int64_t> block_shape(rank);
+    for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+        block_shape[i] = block_end(i, origin[i]) - origin[i];
+    }
+    while (true) {
+        func(block_origin.data(), block_shape.data());
+        tensorstore::DimensionIndex i = rank - 1;
+        for (; i >= 0; --i) {
+            block_origin[i] += block_shape[i];
+            if (block_origin[i] < origin[i] + shape[i]) {
+                block_shape[i] = block_end(i, block_origin[i]) - block_origin[i];
+                break;
+            }
+            block_origin[i] = origin[i];
+            block_shape[i] = block_end(i, origin[i]) - origin[i];
+        }
+        if (i < 0) {
+            return;
+        }
+    }
+}
+
+// Applies `value * scale + offset` to the block at `position` of size `size`
+// within a C-order buffer of `shape`, one contiguous row at a time.
+template <typename T>
+void ScaleOffsetBlock(T* data, const std::vector<int64_t>& shape,
+                      const std::vector<int64_t>& position, const std::vector<int64_t>& size,
+                      T scale, T offset) {
+    const tensorstore::DimensionIndex rank = static_cast<tensorstore::DimensionIndex>(shape.size());
+    std::vector<int64_t> index(rank, 0);  // Row within the block; the last entry stays 0
+    while (true) {
+        int64_t element = 0;
+        for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+            element = element * shape[i] + position[i] + index[i];
+        }
+        ScaleOffset(data + element, static_cast<size_t>(size[rank - 1]), scale, offset);
+        tensorstore::DimensionIndex i = rank - 2;
+        for (; i >= 0; --i) {
+            if (++index[i] < size[i]) {
+                break;
+            }
+            index[i] = 0;
+        }
+        if (i < 0) {
+            return;
+        }
+    }
+}
+
+TSContext* CreateContextFromSpec(const ::nlohmann::json& json_spec, TSError* error) {
+    try {
+        auto spec = tensorstore::Context::Spec::FromJson(json_spec);
+        if (!spec.ok()) {
+            SetError(error, spec.status());
+            return nullptr;
+        }
+        auto context = new TSContext;
+        context->ctx = tensorstore::Context(*spec);
+        return context;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return nullptr;
+    }
+}
+
+TSDataset* NewDatasetHandle(TSContext* context, const char* path,
+                            const DatasetCacheEntry& entry) {
+    auto dataset = new TSDataset;
+    dataset->context = context->ctx;
+    dataset->store = entry.store;
+    dataset->kvstore = entry.kvstore;
+    dataset->path = path;
+    dataset->dtype = entry.dtype;
+    dataset->zarr_format = entry.zarr_format;
+    dataset->raw_chunks = entry.raw_chunks;
+    dataset->metrics = context->metrics;
+    dataset->scratch = context->scratch;
+    dataset->mapped_chunks = CreateMappedChunks(dataset);
+    if (dataset->mapped_chunks) {
+        dataset->mapped_chunks->io_uring = context->io_uring;
+    }
+    return dataset;
+}
+
+::nlohmann::json FileKvStoreSpec(const char* path) {
+    return {{"driver", "file"}, {"path", absl::StrCat(path, "/")}};
+}
+
+TSDataset* CreateDataset(TSContext* context, const char* path, TSDataType dtype,
+                         const int64_t* shape, int rank, const int64_t* chunks,
+                         int shard_size_mb, const CompressionOptions& compression,
+                         TSError* error) {
+    if (!context || !path || !shape || !chunks || rank <= 0) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return nullptr;
+    }
+    try {
+        const ::nlohmann::json kvstore_spec = FileKvStoreSpec(path);
+        auto spec = BuildZarrSpec(kvstore_spec, dtype, shape, rank, chunks, shard_size_mb,
+                                  compression);
+        if (!spec.ok()) {
+            SetError(error, spec.status());
+            return nullptr;
+        }
+
+        // Any cached handle refers to the array about to be replaced.
+        const std::string cache_key = DatasetCache::NormalizePath(path);
+        context->datasets.Erase(cache_key);
+
+        auto store = tensorstore::Open(*spec, context->ctx,
+                                       tensorstore::OpenMode::create |
+                                           tensorstore::OpenMode::delete_existing,
+                                       tensorstore::ReadWriteMode::read_write)
+                         .result();
+        if (!store.ok()) {
+            SetError(error, store.status());
+            return nullptr;
+        }
+        auto kvstore = tensorstore::kvstore::Open(kvstore_spec, context->ctx).result();
+        if (!kvstore.ok()) {
+            SetError(error, kvstore.status());
+            return nullptr;
+        }
+
+        DatasetCacheEntry entry;
+        entry.store = *std::move(store);
+        entry.kvstore = *std::move(kvstore);
+        entry.dtype = dtype;
+        entry.zarr_format = shard_size_mb > 0 ? 3 : 2;
+        entry.raw_chunks = entry.zarr_format == 2 && compression.compressor == "none";
+        context->datasets.Insert(cache_key, /*writable=*/true, entry);
+        return NewDatasetHandle(context, path, entry);
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return nullptr;
+    }
+}
+
+// Chunks of a zarr v2 array can be lent without decoding when they are stored
+// uncompressed, unfiltered, little endian and in C order under "i.j.k" keys.
+bool HasRawChunks(const tensorstore::TensorStore<>& store) {
+    auto spec = store.spec();
+    if (!spec.ok()) {
+        return false;
+    }
+    auto json = spec->ToJson();
+    if (!json.ok() || !json->contains("metadata")) {
+        return false;
+    }
+    const ::nlohmann::json& metadata = (*json)["metadata"];
+    const auto dtype_it = metadata.find("dtype");
+    const std::string dtype = dtype_it != metadata.end() && dtype_it->is_string()
+                                  ? dtype_it->get<std::string>()
+                                  : std::string();
+    return metadata.value("compressor", ::nlohmann::json()).is_null() &&
+           metadata.value("filters", ::nlohmann::json()).is_null() &&
+           metadata.value("order", std::string("C")) == "C" &&
+           metadata.value("dimension_separator", std::string(".")) == "." &&
+           !dtype.empty() && (dtype[0] == '<' || dtype[0] == '|');
+}
+
+tensorstore::Result<DatasetCacheEntry> OpenDataset(TSContext* context, const char* path,
+                                                   bool writable) {
+    const ::nlohmann::json kvstore_spec = FileKvStoreSpec(path);
+    auto kvstore = tensorstore::kvstore::Open(kvstore_spec, context->ctx).result();
+    if (!kvstore.ok()) {
+        return kvstore.status();
+    }
+    // Zarr v3 arrays keep their metadata in zarr.json, v2 arrays in .zarray.
+    auto v3_metadata = tensorstore::kvstore::Read(*kvstore, "zarr.json").result();
+    if (!v3_metadata.ok()) {
+        return v3_metadata.status();
+    }
+    const int zarr_format = v3_metadata->has_value() ? 3 : 2;
+
+    const ::nlohmann::json spec = {
+        {"driver", zarr_format == 3 ? "zarr3" : "zarr"},
+        {"kvstore", kvstore_spec},
+    };
+    auto store = tensorstore::Open(spec, context->ctx, tensorstore::OpenMode::open,
+                                   writable ? tensorstore::ReadWriteMode::read_write
+                                            : tensorstore::ReadWriteMode::read)
+                     .result();
+    if (!store.ok()) {
+        return store.status();
+    }
+
+    DatasetCacheEntry entry;
+    if (!FromTensorstoreDataType(store->dtype(), &entry.dtype)) {
+        return absl::UnimplementedError(
+            absl::StrCat("Unsupported data type: ", store->dtype().name()));
+    }
+    entry.zarr_format = zarr_format;
+    entry.raw_chunks = zarr_format == 2 && HasRawChunks(*store);
+    entry.store = *std::move(store);
+    entry.kvstore = *std::move(kvstore);
+    return entry;
+}
+
+} // namespace
 
 extern "C" {
 
@@ -35,16 +526,459 @@ TSContext* TSCreateContext() {
     }
 }
 
+TSContext* TSCreateContextWithOptions(const TSContextOptions* options, TSError* error) {
+    if (!options) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return nullptr;
+    }
+    ::nlohmann::json spec = ::nlohmann::json::object();
+    if (options->cache_pool_bytes > 0) {
+        spec["cache_pool"] = {{"total_bytes_limit", options->cache_pool_bytes}};
+    }
+    if (options->data_copy_concurrency > 0) {
+        spec["data_copy_concurrency"] = {{"limit", options->data_copy_concurrency}};
+    }
+    if (options->file_io_concurrency > 0) {
+        spec["file_io_concurrency"] = {{"limit", options->file_io_concurrency}};
+    }
+    if (options->file_io_backend != TS_FILE_IO_DEFAULT &&
+        options->file_io_backend != TS_FILE_IO_URING) {
+        SetError(error, absl::InvalidArgumentError("Invalid file I/O backend"));
+        return nullptr;
+    }
+    if (options->file_io_backend == TS_FILE_IO_URING) {
+        auto status = UringAvailable();
+        if (!status.ok()) {
+            SetError(error, status);
+            return nullptr;
+        }
+    }
+    TSContext* context = CreateContextFromSpec(spec, error);
+    if (context) {
+        context->io_uring = options->file_io_backend == TS_FILE_IO_URING;
+    }
+    return context;
+}
+
+TSContext* TSCreateContextFromJson(const char* json_spec, TSError* error) {
+    if (!json_spec) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return nullptr;
+    }
+    auto spec = ::nlohmann::json::parse(json_spec, nullptr, /*allow_exceptions=*/false);
+    if (spec.is_discarded() || !spec.is_object()) {
+        SetError(error, absl::InvalidArgumentError("Context spec is not a JSON object"));
+        return nullptr;
+    }
+    return CreateContextFromSpec(spec, error);
+}
+
 void TSDestroyContext(TSContext* context) {
     delete context;
 }
 
+TSDataset* TSCreateZarr(TSContext* context, const char* path, TSDataType dtype,
+                        const int64_t* shape, int rank, const int64_t* chunks,
+                        int shard_size_mb, TSError* error) {
+    return CreateDataset(context, path, dtype, shape, rank, chunks, shard_size_mb,
+                         CompressionOptions(), error);
+}
+
+TSDataset* TSCreateZarrCompressed(TSContext* context, const char* path, TSDataType dtype,
+                                  const int64_t* shape, int rank, const int64_t* chunks,
+                                  int shard_size_mb, const char* compressor,
+                                  int compression_level, TSError* error) {
+    return TSCreateZarrCompressedEx(context, path, dtype, shape, rank, chunks, shard_size_mb,
+                                    compressor, compression_level, nullptr, 0, 1, 1, error);
+}
+
+TSDataset* TSCreateZarrCompressedEx(TSContext* context, const char* path, TSDataType dtype,
+                                    const int64_t* shape, int rank, const int64_t* chunks,
+                                    int shard_size_mb, const char* compressor,
+                                    int compression_level, const char* blosc_cname,
+                                    int blosc_blocksize, int blosc_shuffle,
+                                    int blosc_num_threads, TSError* error) {
+    // Tensorstore runs codecs on its own data copy executor, so blosc's
+    // internal thread count is not configurable per dataset.
+    (void)blosc_num_threads;
+
+    CompressionOptions compression;
+    if (compressor) compression.compressor = compressor;
+    compression.level = compression_level;
+    if (blosc_cname) compression.blosc_cname = blosc_cname;
+    compression.blosc_blocksize = blosc_blocksize;
+    compression.blosc_shuffle = blosc_shuffle;
+    return CreateDataset(context, path, dtype, shape, rank, chunks, shard_size_mb, compression,
+                         error);
+}
+
+TSDataset* TSCreateZarrWithConfig(TSContext* context, const char* path, TSDataType dtype,
+                                  const int64_t* shape, int rank, const int64_t* chunks,
+                                  int shard_size_mb, const TSCompressionConfig* config,
+                                  TSError* error) {
+    if (!config) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return nullptr;
+    }
+    CompressionOptions compression;
+    compression.compressor = std::string(config->compressor,
+                                         strnlen(config->compressor, sizeof(config->compressor)));
+    compression.level = config->level;
+    if (config->blosc_cname[0]) {
+        compression.blosc_cname = std::string(
+            config->blosc_cname, strnlen(config->blosc_cname, sizeof(config->blosc_cname)));
+    }
+    compression.blosc_blocksize = config->blosc_blocksize;
+    compression.blosc_shuffle = config->blosc_shuffle;
+    return CreateDataset(context, path, dtype, shape, rank, chunks, shard_size_mb, compression,
+                         error);
+}
+
+TSDataset* TSOpenZarr(TSContext* context, const char* path, TSOpenMode mode, TSError* error) {
+    if (!context || !path || (mode != TS_OPEN_READ && mode != TS_OPEN_READ_WRITE)) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return nullptr;
+    }
+    try {
+        const bool writable = mode == TS_OPEN_READ_WRITE;
+        const std::string cache_key = DatasetCache::NormalizePath(path);
+        if (auto cached = context->datasets.Find(cache_key, writable)) {
+            return NewDatasetHandle(context, path, *cached);
+        }
+        auto entry = OpenDataset(context, path, writable);
+        if (!entry.ok()) {
+            SetError(error, entry.status());
+            return nullptr;
+        }
+        context->datasets.Insert(cache_key, writable, *entry);
+        return NewDatasetHandle(context, path, *entry);
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return nullptr;
+    }
+}
+
+void TSCloseDataset(TSDataset* dataset) {
+    if (dataset) {
+        // Errors are dropped here; call TSFlush first to observe them.
+        FlushWriteBack(dataset).IgnoreError();
+        // Finishes queued direct writes while the rest of the handle exists.
+        dataset->direct_write.reset();
+    }
+    delete dataset;
+}
+
+int TSGetShape(TSDataset* dataset, int64_t* shape, int* rank, TSError* error) {
+    if (!dataset || !shape || !rank) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    auto domain_shape = dataset->store.domain().shape();
+    *rank = static_cast<int>(domain_shape.size());
+    std::copy(domain_shape.begin(), domain_shape.end(), shape);
+    return 0;
+}
+
+int TSGetChunkShape(TSDataset* dataset, int64_t* chunks, int* rank, TSError* error) {
+    if (!dataset || !chunks || !rank) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    auto layout = dataset->store.chunk_layout();
+    if (!layout.ok()) {
+        SetError(error, layout.status());
+        return -1;
+    }
+    auto chunk_shape = layout->read_chunk_shape();
+    *rank = static_cast<int>(chunk_shape.size());
+    std::copy(chunk_shape.begin(), chunk_shape.end(), chunks);
+    return 0;
+}
+
+int TSGetDataType(TSDataset* dataset, TSDataType* dtype, TSError* error) {
+    if (!dataset || !dtype) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    *dtype = dataset->dtype;
+    return 0;
+}
+
+size_t TSGetDataTypeSize(TSDataType dtype) {
+    const tensorstore::DataType ts_dtype = ToTensorstoreDataType(dtype);
+    return ts_dtype.valid() ? static_cast<size_t>(ts_dtype.size()) : 0;
+}
+
+int TSReadUInt16(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                 uint16_t* data, TSError* error) {
+    return TSRead(dataset, origin, shape, TS_UINT16, data, error);
+}
+
+int TSWriteUInt16(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                  const uint16_t* data, TSError* error) {
+    return TSWrite(dataset, origin, shape, TS_UINT16, data, error);
+}
+
+int TSRead(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+           TSDataType dtype, void* data, TSError* error) {
+    if (!CheckRegionArgs(dataset, origin, shape, data, error) ||
+        !CheckDataType(dataset, dtype, error)) {
+        return -1;
+    }
+    bool mapped;
+    auto status = ReadRegion(dataset, origin, shape, data, nullptr, &mapped);
+    if (!status.ok()) {
+        SetError(error, status);
+        return -1;
+    }
+    // Mapped reads leave read-ahead to the page cache.
+    if (!mapped) {
+        NotePrefetchAccess(dataset, origin, shape);
+    }
+    return 0;
+}
+
+int TSWrite(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+            TSDataType dtype, const void* data, TSError* error) {
+    if (!CheckRegionArgs(dataset, origin, shape, data, error) ||
+        !CheckDataType(dataset, dtype, error)) {
+        return -1;
+    }
+    auto status = StartWrite(dataset, origin, shape, data).status();
+    if (!status.ok()) {
+        SetError(error, status);
+        return -1;
+    }
+    return 0;
+}
+
+int TSReadConvert(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                  TSDataType dtype, void* data, double scale, double offset,
+                  TSError* error) {
+    if (!CheckRegionArgs(dataset, origin, shape, data, error)) {
+        return -1;
+    }
+    const tensorstore::DataType target = ToTensorstoreDataType(dtype);
+    if (!target.valid()) {
+        SetError(error, absl::InvalidArgumentError("Invalid data type"));
+        return -1;
+    }
+    const bool affine = scale != 1.0 || offset != 0.0;
+    if (affine && dtype != TS_FLOAT32 && dtype != TS_FLOAT64) {
+        SetError(error, absl::InvalidArgumentError(
+                            "Scale and offset require a float32 or float64 destination"));
+        return -1;
+    }
+    try {
+        const tensorstore::DimensionIndex rank = dataset->store.rank();
+        // The cast is applied while copying out of each decoded chunk, so no
+        // buffer of the stored type is materialised.
+        auto future = ReadWithWriteBack(
+            dataset,
+            [&](const tensorstore::Transaction& transaction) -> tensorstore::Future<void> {
+                auto region = GetRegion(dataset, origin, shape, transaction);
+                if (!region.ok()) {
+                    return tensorstore::MakeReadyFuture<void>(region.status());
+                }
+                auto converted = tensorstore::Cast(*region, target);
+                if (!converted.ok()) {
+                    return tensorstore::MakeReadyFuture<void>(converted.status());
+                }
+                return tensorstore::Read(*converted,
+                                         WrapBuffer(target, rank, data, shape, nullptr));
+            });
+        TrackOperation(dataset->metrics, ContextMetrics::kRead, RegionBytes(dataset, shape),
+                       future);
+        auto status = future.status();
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        if (!affine) {
+            return 0;
+        }
+
+        // Scale and offset are applied afterwards, over read chunk sized
+        // blocks of the converted buffer.
+        const std::vector<int64_t> buffer_shape(shape, shape + rank);
+        ForEachReadChunkBlock(dataset, origin, shape, [&](const int64_t* block_origin,
+                                                          const int64_t* block_shape) {
+            std::vector<int64_t> position(rank);  // Block origin within `data`
+            for (tensorstore::DimensionIndex i = 0; i < rank; ++i) {
+                position[i] = block_origin[i] - origin[i];
+            }
+            const std::vector<int64_t> size(block_shape, block_shape + rank);
+            if (dtype == TS_FLOAT32) {
+                ScaleOffsetBlock(static_cast<float*>(data), buffer_shape, position, size,
+                                 static_cast<float>(scale), static_cast<float>(offset));
+            } else {
+                ScaleOffsetBlock(static_cast<double*>(data), buffer_shape, position, size,
+                                 scale, offset);
+            }
+        });
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSReadStrided(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                  void* data, const int64_t* byte_strides, TSError* error) {
+    if (!CheckRegionArgs(dataset, origin, shape, data, error)) {
+        return -1;
+    }
+    bool mapped;
+    auto status = ReadRegion(dataset, origin, shape, data, byte_strides, &mapped);
+    if (!status.ok()) {
+        SetError(error, status);
+        return -1;
+    }
+    return 0;
+}
+
+int TSWriteStrided(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                   const void* data, const int64_t* byte_strides, TSError* error) {
+    if (!CheckRegionArgs(dataset, origin, shape, data, error)) {
+        return -1;
+    }
+    auto status = StartWrite(dataset, origin, shape, data, byte_strides).status();
+    if (!status.ok()) {
+        SetError(error, status);
+        return -1;
+    }
+    return 0;
+}
+
+TSFuture* TSReadAsync(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                      void* data, TSError* error) {
+    if (!CheckRegionArgs(dataset, origin, shape, data, error)) {
+        return nullptr;
+    }
+    try {
+        auto future = new TSFuture;
+        future->future = StartRead(dataset, origin, shape, data);
+        return future;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return nullptr;
+    }
+}
+
+TSFuture* TSWriteAsync(TSDataset* dataset, const int64_t* origin, const int64_t* shape,
+                       const void* data, TSError* error) {
+    if (!CheckRegionArgs(dataset, origin, shape, data, error)) {
+        return nullptr;
+    }
+    try {
+        auto future = new TSFuture;
+        future->future = StartWrite(dataset, origin, shape, data);
+        return future;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return nullptr;
+    }
+}
+
+int TSFutureIsReady(TSFuture* future) {
+    return future && future->future.ready() ? 1 : 0;
+}
+
+int TSFutureWait(TSFuture* future, int64_t timeout_ms, TSError* error) {
+    if (!future) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    if (timeout_ms < 0) {
+        future->future.Wait();
+    } else if (!future->future.WaitFor(absl::Milliseconds(timeout_ms))) {
+        return 1;
+    }
+    const absl::Status& status = future->future.status();
+    if (!status.ok()) {
+        SetError(error, status);
+        return -1;
+    }
+    return 0;
+}
+
+int TSFutureSetCallback(TSFuture* future, TSFutureCallback callback, void* user_data,
+                        TSError* error) {
+    if (!future || !callback) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    // The registration keeps the operation alive on its own, so the callback
+    // still fires if the TSFuture is destroyed first.
+    future->future.ExecuteWhenReady(
+        [callback, user_data](tensorstore::ReadyFuture<void> ready) {
+            callback(user_data, static_cast<int>(ready.status().code()));
+        });
+    return 0;
+}
+
+void TSDestroyFuture(TSFuture* future) {
+    if (future && !future->future.ready()) {
+        // Dropping the last Future reference would mark the result as no
+        // longer needed and let tensorstore cancel the operation. Park a
+        // reference on a no-op callback so it runs to completion instead.
+        future->future.Force();
+        future->future.ExecuteWhenReady([](tensorstore::ReadyFuture<void>) {});
+    }
+    delete future;
+}
+
+int TSReadBatch(TSDataset* dataset, const TSRegion* regions, size_t count, TSError* error) {
+    if (!dataset || (!regions && count > 0)) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!CheckRegionArgs(dataset, regions[i].origin, regions[i].shape, regions[i].data, error)) {
+            return -1;
+        }
+    }
+    try {
+        // Issuing every read under one batch lets tensorstore coalesce the
+        // requests per chunk, so a chunk touched by several regions is
+        // fetched and decoded once. The batch is submitted when it goes out
+        // of scope; the copies into each region then run concurrently on the
+        // context's data copy executor.
+        std::vector<tensorstore::Future<void>> futures;
+        futures.reserve(count);
+        {
+            tensorstore::Batch batch = tensorstore::Batch::New();
+            for (size_t i = 0; i < count; ++i) {
+                futures.push_back(StartRead(dataset, regions[i].origin, regions[i].shape,
+                                            regions[i].data, nullptr, batch));
+            }
+        }
+
+        int result = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const absl::Status& status = futures[i].status();
+            if (!status.ok() && result == 0) {
+                SetError(error, absl::Status(status.code(),
+                                             absl::StrCat("Region ", i, ": ", status.message())));
+                result = -1;
+            }
+        }
+        return result;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+const char* TSErrorMessage(const TSError* error) {
+    return error && error->message ? ErrorMessage(error) : nullptr;
+}
+
 void TSClearError(TSError* error) {
     if (error && error->message) {
-        free((void*)error->message);
-        error->message = nullptr;
+        ReleaseErrorMessage(error);
         error->code = 0;
     }
 }
 
-} // extern "C"
\ No newline at end of file
+} // extern "C"
@@ -0,0 +1,319 @@
+#include "uring_reader.h"
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+#endif
+
+#ifdef __linux__
+
+namespace {
+
+// Submission queue depth of each thread's ring.
+constexpr unsigned kRingEntries = 256;
+
+// Minimal io_uring instance driven through the raw system calls, so no
+// liburing dependency is needed. Only the owning thread touches it.
+class Ring {
+public:
+    static absl::Status Create(std::unique_ptr<Ring>* ring);
+    ~Ring();
+
+    unsigned entries() const { return entries_; }
+
+    // Queues a read of `size` bytes at `offset` of `fd` into `buffer`.
+    // Must not be called with `entries()` reads already queued.
+    void PrepareRead(int fd, char* buffer, unsigned size, uint64_t offset, uint64_t user_data);
+
+    // Submits the queued reads and waits for at least `wait_for` completions.
+    // On failure, queued reads the kernel did not take are dropped and
+    // counted in `*dropped`; the ones it took are still in flight.
+    absl::Status Submit(unsigned wait_for, unsigned* dropped);
+
+    // Calls `handle(user_data, result)` for each available completion.
+    template <typename Handler>
+    void Reap(Handler&& handle);
+
+private:
+    Ring() = default;
+
+    int fd_ = -1;
+    unsigned entries_ = 0;
+    unsigned to_submit_ = 0;
+    void* sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+absl::Status Ring::Create(std::unique_ptr<Ring>* result) {
+    std::unique_ptr<Ring> ring(new Ring);
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring->fd_ = static_cast<int>(syscall(__NR_io_uring_setup, kRingEntries, &params));
+    if (ring->fd_ < 0) {
+        return absl::ErrnoToStatus(errno, "io_uring_setup failed");
+    }
+    ring->entries_ = params.sq_entries;
+
+    ring->sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        ring->sq_ring_size_ = ring->cq_ring_size_ =
+            std::max(ring->sq_ring_size_, ring->cq_ring_size_);
+    }
+    ring->sq_ring_ = mmap(nullptr, ring->sq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->fd_, IORING_OFF_SQ_RING);
+    if (ring->sq_ring_ == MAP_FAILED) {
+        ring->sq_ring_ = nullptr;
+        return absl::ErrnoToStatus(errno, "Failed to map io_uring submission queue");
+    }
+    if (single_mmap) {
+        ring->cq_ring_ = ring->sq_ring_;
+    } else {
+        ring->cq_ring_ = mmap(nullptr, ring->cq_ring_size_, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ring->fd_, IORING_OFF_CQ_RING);
+        if (ring->cq_ring_ == MAP_FAILED) {
+            ring->cq_ring_ = nullptr;
+            return absl::ErrnoToStatus(errno, "Failed to map io_uring completion queue");
+        }
+    }
+    ring->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return absl::ErrnoToStatus(errno, "Failed to map io_uring submission entries");
+    }
+    ring->sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(ring->sq_ring_);
+    char* cq = static_cast<char*>(ring->cq_ring_);
+    ring->sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    *result = std::move(ring);
+    return absl::OkStatus();
+}
+
+Ring::~Ring() {
+    if (sqes_) munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+    if (fd_ >= 0) close(fd_);
+}
+
+void Ring::PrepareRead(int fd, char* buffer, unsigned size, uint64_t offset,
+                       uint64_t user_data) {
+    const unsigned tail = *sq_tail_ + to_submit_;
+    const unsigned index = tail & *sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    sq_array_[index] = index;
+    ++to_submit_;
+}
+
+absl::Status Ring::Submit(unsigned wait_for, unsigned* dropped) {
+    // Publish the new entries before the kernel sees the tail.
+    __atomic_store_n(sq_tail_, *sq_tail_ + to_submit_, __ATOMIC_RELEASE);
+    unsigned remaining = to_submit_;
+    to_submit_ = 0;
+    while (true) {
+        const long submitted = syscall(__NR_io_uring_enter, fd_, remaining, wait_for,
+                                       wait_for ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (submitted >= 0) {
+            remaining -= static_cast<unsigned>(submitted);
+            if (remaining == 0) return absl::OkStatus();
+            continue;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            const int error = errno;
+            // Take back the entries the kernel did not consume so they are
+            // not submitted with a later batch. Without SQPOLL the kernel only
+            // reads the queue inside io_uring_enter, so this cannot race.
+            const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            *dropped = *sq_tail_ - head;
+            __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+            return absl::ErrnoToStatus(error, "io_uring_enter failed");
+        }
+    }
+}
+
+template <typename Handler>
+void Ring::Reap(Handler&& handle) {
+    unsigned head = *cq_head_;
+    const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+        handle(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+thread_local std::unique_ptr<Ring> thread_ring;
+
+absl::Status ThreadRing(Ring** ring) {
+    if (!thread_ring) {
+        auto status = Ring::Create(&thread_ring);
+        if (!status.ok()) {
+            return status;
+        }
+    }
+    *ring = thread_ring.get();
+    return absl::OkStatus();
+}
+
+// Closes the files of a batch however it ends.
+struct FileDescriptors {
+    std::vector<int> fds;
+    ~FileDescriptors() {
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+};
+
+} // namespace
+
+absl::Status UringAvailable() {
+    Ring* ring;
+    return ThreadRing(&ring);
+}
+
+absl::Status UringReadFiles(std::vector<FileRead>& reads) {
+    Ring* ring;
+    auto status = ThreadRing(&ring);
+    if (!status.ok()) {
+        return status;
+    }
+
+    FileDescriptors files;
+    files.fds.assign(reads.size(), -1);
+    std::deque<size_t> pending;
+    for (size_t i = 0; i < reads.size(); ++i) {
+        FileRead& read = reads[i];
+        read.bytes_read = 0;
+        files.fds[i] = open(read.path.c_str(), O_RDONLY | O_CLOEXEC);
+        read.found = files.fds[i] >= 0;
+        if (!read.found) {
+            if (errno == ENOENT) continue;
+            return absl::ErrnoToStatus(errno, absl::StrCat("Failed to open ", read.path));
+        }
+        if (read.size > 0) pending.push_back(i);
+    }
+
+    // Short reads are resubmitted for the remainder until the file ends. After
+    // an error nothing new is queued, but the loop keeps reaping until no
+    // read is in flight, since the kernel writes into the buffers and reads
+    // from the files until each read completes.
+    unsigned in_flight = 0;
+    absl::Status first_error;
+    std::vector<size_t> batch;
+    while (!pending.empty() || in_flight > 0) {
+        unsigned queued = 0;
+        batch.clear();
+        while (!pending.empty() && in_flight + queued < ring->entries() && first_error.ok()) {
+            const size_t i = pending.front();
+            pending.pop_front();
+            FileRead& read = reads[i];
+            const size_t remaining = std::min<size_t>(read.size - read.bytes_read, 1u << 30);
+            ring->PrepareRead(files.fds[i], read.buffer + read.bytes_read,
+                              static_cast<unsigned>(remaining), read.bytes_read, i);
+            read.in_flight = true;
+            batch.push_back(i);
+            ++queued;
+        }
+        if (queued == 0 && in_flight == 0) break;
+        in_flight += queued;
+        unsigned dropped = 0;
+        status = ring->Submit(1, &dropped);
+        if (!status.ok()) {
+            if (queued == 0) {
+                // Waiting alone failed, so the ring is broken and the reads
+                // in flight can never be reaped. Closing the ring cancels
+                // them, but only asynchronously, so their buffers are marked
+                // as still in use and the next batch gets a new ring.
+                ring->Reap([&](uint64_t user_data, int) { reads[user_data].in_flight = false; });
+                thread_ring.reset();
+                return status;
+            }
+            // The dropped entries are the last ones queued.
+            for (unsigned d = 0; d < dropped; ++d) {
+                reads[batch[batch.size() - 1 - d]].in_flight = false;
+            }
+            in_flight -= dropped;
+            if (first_error.ok()) {
+                first_error = status;
+            }
+        }
+        ring->Reap([&](uint64_t user_data, int result) {
+            --in_flight;
+            FileRead& read = reads[user_data];
+            read.in_flight = false;
+            if (result < 0) {
+                if (result == -EINTR || result == -EAGAIN) {
+                    pending.push_back(user_data);
+                } else if (first_error.ok()) {
+                    first_error = absl::ErrnoToStatus(-result,
+                                                      absl::StrCat("Failed to read ", read.path));
+                }
+                return;
+            }
+            read.bytes_read += static_cast<size_t>(result);
+            if (result > 0 && read.bytes_read < read.size) {
+                pending.push_back(user_data);
+            }
+        });
+        if (!first_error.ok()) {
+            pending.clear();
+        }
+    }
+    return first_error;
+}
+
+#else
+
+absl::Status UringAvailable() {
+    return absl::UnimplementedError("io_uring is only available on Linux");
+}
+
+absl::Status UringReadFiles(std::vector<FileRead>&) {
+    return UringAvailable();
+}
+
+#endif
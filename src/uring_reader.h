@@ -0,0 +1,35 @@
+#ifndef TENSORSTORE_DLL_URING_READER_H_
+#define TENSORSTORE_DLL_URING_READER_H_
+
+#include "absl/status/status.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// One whole-file read of a batch submitted through UringReadFiles.
+struct FileRead {
+    std::string path;
+    char* buffer = nullptr;
+    size_t size = 0;         // Bytes to read from the start of the file
+    bool found = false;      // Set if the file exists
+    size_t bytes_read = 0;   // Less than `size` if the file is shorter
+    bool in_flight = false;  // Set if the kernel may still write to `buffer`
+};
+
+// Returns OK if io_uring can be used by this process (Linux 5.6 or newer,
+// and not blocked by a seccomp policy).
+absl::Status UringAvailable();
+
+// Reads all files of the batch through the calling thread's io_uring
+// instance. The files are opened synchronously first; then all reads are
+// submitted together, up to the ring size, and completions are reaped in
+// batches, so a single thread keeps many read requests queued on the device.
+// The queue depth therefore applies to the read phase only. Files that do
+// not exist are skipped. On error, the call returns once no read is in
+// flight, unless the ring itself fails; it is then closed, and reads that
+// were still queued keep `in_flight` set. Their buffers must be leaked, since
+// the kernel cancels the reads asynchronously.
+absl::Status UringReadFiles(std::vector<FileRead>& reads);
+
+#endif // TENSORSTORE_DLL_URING_READER_H_
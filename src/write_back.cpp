@@ -0,0 +1,198 @@
+#include "handles.h"
+#include "write_back.h"
+#include "error_handling.h"
+
+#include "tensorstore/chunk_layout.h"
+#include "tensorstore/util/executor.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_join.h"
+
+#include <memory>
+#include <utility>
+
+namespace {
+
+// Starts committing the current transaction and returns the future of the
+// last commit, which is ready once every commit started so far has finished.
+// Commits are chained so chunks staged in two transactions reach storage in
+// order. Must be called with the mutex held; the future is waited on after
+// releasing it, so writes can stage into a new transaction meanwhile.
+tensorstore::Future<const void> StartCommitLocked(WriteBackCache* cache) {
+    if (cache->transaction == tensorstore::no_transaction) {
+        return cache->committing.null() ? tensorstore::MakeReadyFuture() : cache->committing;
+    }
+    tensorstore::Transaction transaction = std::move(cache->transaction);
+    cache->transaction = tensorstore::Transaction(tensorstore::no_transaction);
+    cache->dirty_chunks.clear();
+    if (cache->committing.null() || cache->committing.ready()) {
+        cache->committing = transaction.CommitAsync();
+    } else {
+        auto pair = tensorstore::PromiseFuturePair<void>::Make();
+        cache->committing.ExecuteWhenReady(
+            [promise = std::move(pair.promise),
+             transaction](tensorstore::ReadyFuture<const void>) mutable {
+                tensorstore::LinkResult(std::move(promise), transaction.CommitAsync());
+            });
+        cache->committing = std::move(pair.future);
+    }
+    return cache->committing;
+}
+
+// Grid positions of the read chunks intersecting [origin, origin + shape).
+std::vector<std::string> ChunkKeys(const WriteBackCache& cache, const int64_t* origin,
+                                   const int64_t* shape) {
+    const size_t rank = cache.chunk_shape.size();
+    std::vector<tensorstore::Index> first(rank), last(rank), position(rank);
+    for (size_t i = 0; i < rank; ++i) {
+        if (shape[i] <= 0) return {};
+        first[i] = origin[i] / cache.chunk_shape[i];
+        last[i] = (origin[i] + shape[i] - 1) / cache.chunk_shape[i];
+    }
+    std::vector<std::string> keys;
+    position = first;
+    while (true) {
+        keys.push_back(absl::StrJoin(position, ","));
+        size_t d = rank;
+        while (d > 0) {
+            --d;
+            if (++position[d] <= last[d]) break;
+            position[d] = first[d];
+            if (d == 0) return keys;
+        }
+        if (rank == 0) return keys;
+    }
+}
+
+} // namespace
+
+tensorstore::Future<void> ReadWithWriteBack(TSDataset* dataset, const IssueFunction& issue) {
+    WriteBackCache* cache = dataset->write_back.get();
+    if (!cache) {
+        return issue(tensorstore::Transaction(tensorstore::no_transaction));
+    }
+    tensorstore::Future<const void> committing;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        committing = cache->committing;
+    }
+    // Chunks of a commit in progress are neither in the current transaction
+    // nor necessarily in storage yet.
+    if (!committing.null()) {
+        committing.Wait();
+    }
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    return issue(cache->transaction);
+}
+
+tensorstore::Future<void> StageWriteBack(TSDataset* dataset, const int64_t* origin,
+                                         const int64_t* shape, const IssueFunction& issue) {
+    WriteBackCache* cache = dataset->write_back.get();
+    if (!cache) {
+        return issue(tensorstore::Transaction(tensorstore::no_transaction));
+    }
+    tensorstore::Future<void> staged;
+    tensorstore::Future<const void> flush;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        std::vector<std::string> keys = ChunkKeys(*cache, origin, shape);
+        size_t new_chunks = 0;
+        for (const std::string& key : keys) {
+            new_chunks += cache->dirty_chunks.count(key) == 0;
+        }
+        const int64_t staged_bytes =
+            static_cast<int64_t>(cache->dirty_chunks.size() + new_chunks) * cache->chunk_bytes;
+        if (staged_bytes > cache->budget_bytes && !cache->dirty_chunks.empty()) {
+            flush = StartCommitLocked(cache);
+        }
+        if (cache->transaction == tensorstore::no_transaction) {
+            cache->transaction = tensorstore::Transaction(tensorstore::isolated);
+        }
+        cache->dirty_chunks.insert(std::make_move_iterator(keys.begin()),
+                                   std::make_move_iterator(keys.end()));
+        staged = issue(cache->transaction);
+    }
+    if (flush.null()) {
+        return staged;
+    }
+    // The write that triggers a flush reports its storage errors.
+    const tensorstore::AnyFuture parts[] = {flush, staged};
+    return tensorstore::MapFuture(
+        tensorstore::InlineExecutor{},
+        [flush, staged](const tensorstore::Result<void>&) {
+            absl::Status status = flush.status();
+            status.Update(staged.status());
+            return tensorstore::MakeResult(status);
+        },
+        tensorstore::WaitAllFuture(parts));
+}
+
+absl::Status FlushWriteBack(TSDataset* dataset) {
+    WriteBackCache* cache = dataset->write_back.get();
+    if (!cache) {
+        return absl::OkStatus();
+    }
+    tensorstore::Future<const void> flush;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        flush = StartCommitLocked(cache);
+    }
+    return flush.status();
+}
+
+extern "C" {
+
+int TSSetWriteBackCache(TSDataset* dataset, int64_t budget_bytes, TSError* error) {
+    if (!dataset || budget_bytes < 0) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        // Staged writes are committed before the mode or budget changes.
+        auto status = FlushWriteBack(dataset);
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        if (budget_bytes == 0) {
+            dataset->write_back.reset();
+            return 0;
+        }
+        auto layout = dataset->store.chunk_layout();
+        if (!layout.ok()) {
+            SetError(error, layout.status());
+            return -1;
+        }
+        auto cache = std::make_unique<WriteBackCache>();
+        cache->budget_bytes = budget_bytes;
+        cache->chunk_bytes = ToTensorstoreDataType(dataset->dtype).size();
+        for (tensorstore::Index extent : layout->read_chunk_shape()) {
+            cache->chunk_shape.push_back(extent > 0 ? extent : 1);
+            cache->chunk_bytes *= cache->chunk_shape.back();
+        }
+        dataset->write_back = std::move(cache);
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+int TSFlush(TSDataset* dataset, TSError* error) {
+    if (!dataset) {
+        SetError(error, absl::InvalidArgumentError("Invalid arguments"));
+        return -1;
+    }
+    try {
+        auto status = FlushWriteBack(dataset);
+        if (!status.ok()) {
+            SetError(error, status);
+            return -1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        SetError(error, e.what());
+        return -1;
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,54 @@
+#ifndef TENSORSTORE_DLL_WRITE_BACK_H_
+#define TENSORSTORE_DLL_WRITE_BACK_H_
+
+#include "tensorstore/index.h"
+#include "tensorstore/transaction.h"
+#include "tensorstore/util/future.h"
+#include "absl/status/status.h"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct TSDataset;
+
+// Write-back state of a dataset. Writes are staged in an isolated tensorstore
+// transaction, where partial writes to the same chunk are merged in its
+// decoded form. The transaction is committed, encoding and writing each dirty
+// chunk once, when the staged chunks would exceed `budget_bytes`, on
+// TSFlush, or when the dataset is closed.
+struct WriteBackCache {
+    std::mutex mutex;
+    int64_t budget_bytes = 0;
+    int64_t chunk_bytes = 0;                    // Decoded size of one read chunk
+    std::vector<tensorstore::Index> chunk_shape;
+    tensorstore::Transaction transaction{tensorstore::no_transaction};
+    std::unordered_set<std::string> dirty_chunks;  // Grid positions, "i,j,k"
+    tensorstore::Future<const void> committing;    // Last commit started, if any
+};
+
+// Issues one tensorstore operation of a dataset, bound to the transaction it
+// receives. It is called with the write-back mutex held, so the transaction
+// cannot start committing before the operation is part of it.
+using IssueFunction =
+    std::function<tensorstore::Future<void>(const tensorstore::Transaction& transaction)>;
+
+// Issues a read bound to the write-back transaction, so it observes staged
+// writes, or to no_transaction when write-back is disabled. Waits first for
+// any commit in progress, whose chunks may not have reached storage yet.
+tensorstore::Future<void> ReadWithWriteBack(TSDataset* dataset, const IssueFunction& issue);
+
+// Records a write of [origin, origin + shape) and issues it in the write-back
+// transaction, or without one when write-back is disabled. Starts committing
+// the staged chunks first if the new ones would exceed the budget; the
+// returned future then also reports the errors of that commit.
+tensorstore::Future<void> StageWriteBack(TSDataset* dataset, const int64_t* origin,
+                                         const int64_t* shape, const IssueFunction& issue);
+
+// Commits all staged writes and waits for them to reach storage.
+absl::Status FlushWriteBack(TSDataset* dataset);
+
+#endif // TENSORSTORE_DLL_WRITE_BACK_H_
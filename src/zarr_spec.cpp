@@ -0,0 +1,176 @@
+#include "zarr_spec.h"
+#include "data_types.h"
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr int64_t kMaxExtent = std::numeric_limits<int64_t>::max();
+
+// a * b for non-negative values, saturated at kMaxExtent.
+int64_t SaturatingMultiply(int64_t a, int64_t b) {
+    return a != 0 && b > kMaxExtent / a ? kMaxExtent : a * b;
+}
+
+// Smallest multiple of `multiple` not below `value`, saturated at kMaxExtent.
+int64_t RoundUp(int64_t value, int64_t multiple) {
+    const int64_t chunks = value / multiple + (value % multiple != 0);
+    return SaturatingMultiply(chunks, multiple);
+}
+
+const char* const kBloscShuffleNames[] = {"noshuffle", "shuffle", "bitshuffle"};
+
+absl::Status CheckCompression(const CompressionOptions& compression) {
+    if (compression.compressor != "none" && compression.compressor != "zstd" &&
+        compression.compressor != "blosc") {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Unsupported compressor: ", compression.compressor));
+    }
+    if (compression.blosc_shuffle < 0 || compression.blosc_shuffle > 2) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Invalid blosc shuffle mode: ", compression.blosc_shuffle));
+    }
+    return absl::OkStatus();
+}
+
+::nlohmann::json ZarrV2Compressor(const CompressionOptions& compression) {
+    if (compression.compressor == "zstd") {
+        return {{"id", "zstd"}, {"level", compression.level}};
+    }
+    if (compression.compressor == "blosc") {
+        return {
+            {"id", "blosc"},
+            {"cname", compression.blosc_cname},
+            {"clevel", compression.level},
+            {"shuffle", compression.blosc_shuffle},
+            {"blocksize", compression.blosc_blocksize},
+        };
+    }
+    return nullptr;
+}
+
+// Codec chain applied to each inner chunk of a shard.
+::nlohmann::json ZarrV3ChunkCodecs(const CompressionOptions& compression, int64_t element_size) {
+    ::nlohmann::json codecs = ::nlohmann::json::array();
+    codecs.push_back({{"name", "bytes"}, {"configuration", {{"endian", "little"}}}});
+    if (compression.compressor == "zstd") {
+        codecs.push_back({{"name", "zstd"}, {"configuration", {{"level", compression.level}}}});
+    } else if (compression.compressor == "blosc") {
+        codecs.push_back({
+            {"name", "blosc"},
+            {"configuration", {
+                {"cname", compression.blosc_cname},
+                {"clevel", compression.level},
+                {"shuffle", kBloscShuffleNames[compression.blosc_shuffle]},
+                {"typesize", element_size},
+                {"blocksize", compression.blosc_blocksize},
+            }},
+        });
+    }
+    return codecs;
+}
+
+} // namespace
+
+std::vector<int64_t> ComputeShardShape(const int64_t* shape, const int64_t* chunks, int rank,
+                                       int64_t element_size, int64_t target_bytes) {
+    std::vector<int64_t> shard(chunks, chunks + rank);
+    int64_t shard_bytes = element_size;
+    for (int i = 0; i < rank; ++i) shard_bytes = SaturatingMultiply(shard_bytes, shard[i]);
+
+    while (true) {
+        // Grow the dimension that currently covers the least of the dataset.
+        // Coverage is compared as a ratio, since the cross products can
+        // overflow for large shapes.
+        int grow = -1;
+        for (int i = 0; i < rank; ++i) {
+            if (shard[i] < RoundUp(shape[i], chunks[i]) &&
+                (grow < 0 || static_cast<double>(shard[i]) / shape[i] <
+                                 static_cast<double>(shard[grow]) / shape[grow])) {
+                grow = i;
+            }
+        }
+        if (grow < 0) break;
+
+        const int64_t grown = std::min(SaturatingMultiply(shard[grow], 2),
+                                       RoundUp(shape[grow], chunks[grow]));
+        const int64_t grown_bytes = SaturatingMultiply(shard_bytes / shard[grow], grown);
+        if (grown_bytes > target_bytes) break;
+        shard[grow] = grown;
+        shard_bytes = grown_bytes;
+    }
+    return shard;
+}
+
+tensorstore::Result<::nlohmann::json> BuildZarrSpec(const ::nlohmann::json& kvstore_spec,
+                                                    TSDataType dtype, const int64_t* shape,
+                                                    int rank, const int64_t* chunks,
+                                                    int shard_size_mb,
+                                                    const CompressionOptions& compression) {
+    const tensorstore::DataType ts_dtype = ToTensorstoreDataType(dtype);
+    if (!ts_dtype.valid()) {
+        return absl::InvalidArgumentError("Invalid data type");
+    }
+    for (int i = 0; i < rank; ++i) {
+        if (shape[i] < 0 || chunks[i] <= 0) {
+            return absl::InvalidArgumentError(
+                absl::StrCat("Invalid shape or chunk extent in dimension ", i));
+        }
+    }
+    auto status = CheckCompression(compression);
+    if (!status.ok()) {
+        return status;
+    }
+
+    const std::vector<int64_t> shape_vec(shape, shape + rank);
+    const std::vector<int64_t> chunk_vec(chunks, chunks + rank);
+
+    if (shard_size_mb <= 0) {
+        return ::nlohmann::json{
+            {"driver", "zarr"},
+            {"kvstore", kvstore_spec},
+            {"metadata", {
+                {"dtype", ToZarrDataType(dtype)},
+                {"shape", shape_vec},
+                {"chunks", chunk_vec},
+                {"compressor", ZarrV2Compressor(compression)},
+            }},
+        };
+    }
+
+    const std::vector<int64_t> shard_shape = ComputeShardShape(
+        shape, chunks, rank, ts_dtype.size(), static_cast<int64_t>(shard_size_mb) << 20);
+    ::nlohmann::json sharding = {
+        {"name", "sharding_indexed"},
+        {"configuration", {
+            {"chunk_shape", chunk_vec},
+            {"codecs", ZarrV3ChunkCodecs(compression, ts_dtype.size())},
+            {"index_codecs", ::nlohmann::json::array({
+                {{"name", "bytes"}, {"configuration", {{"endian", "little"}}}},
+                {{"name", "crc32c"}},
+            })},
+            {"index_location", "end"},
+        }},
+    };
+    return ::nlohmann::json{
+        {"driver", "zarr3"},
+        {"kvstore", kvstore_spec},
+        {"metadata", {
+            {"zarr_format", 3},
+            {"node_type", "array"},
+            {"shape", shape_vec},
+            {"data_type", ToZarr3DataType(dtype)},
+            {"chunk_grid", {
+                {"name", "regular"},
+                {"configuration", {{"chunk_shape", shard_shape}}},
+            }},
+            {"chunk_key_encoding", {{"name", "default"}}},
+            {"fill_value", 0},
+            {"codecs", ::nlohmann::json::array({sharding})},
+        }},
+    };
+}
@@ -0,0 +1,38 @@
+#ifndef TENSORSTORE_DLL_ZARR_SPEC_H_
+#define TENSORSTORE_DLL_ZARR_SPEC_H_
+
+#include "tensorstore_dll/span_fix.h"  // Must come first
+#include "tensorstore_dll/tensorstore_dll.h"
+
+#include "tensorstore/util/result.h"
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Chunk compression settings accepted by TSCreateZarrCompressed.
+struct CompressionOptions {
+    std::string compressor = "none";  // "none", "zstd" or "blosc"
+    int level = 0;
+    std::string blosc_cname = "lz4";
+    int blosc_blocksize = 0;          // 0 lets blosc choose
+    int blosc_shuffle = 1;            // 0 = none, 1 = byte, 2 = bit
+};
+
+// Smallest-first doubling of the chunk shape, per dimension, until the shard
+// reaches `target_bytes` or covers the whole dataset. The result is always a
+// multiple of `chunks`.
+std::vector<int64_t> ComputeShardShape(const int64_t* shape, const int64_t* chunks, int rank,
+                                       int64_t element_size, int64_t target_bytes);
+
+// Builds a tensorstore spec for a new zarr array stored in `kvstore_spec`.
+// A positive `shard_size_mb` selects the zarr3 driver with the
+// sharding_indexed codec; otherwise a plain zarr v2 array is created.
+tensorstore::Result<::nlohmann::json> BuildZarrSpec(const ::nlohmann::json& kvstore_spec,
+                                                    TSDataType dtype, const int64_t* shape,
+                                                    int rank, const int64_t* chunks,
+                                                    int shard_size_mb,
+                                                    const CompressionOptions& compression);
+
+#endif // TENSORSTORE_DLL_ZARR_SPEC_H_
@@ -1,10 +1,36 @@
 #include "gtest/gtest.h"
 #include "tensorstore_dll/tensorstore_dll.h"
 #include "tensorstore_dll/version.h"
+#include <nlohmann/json.hpp>
 #include <vector>
+#include <string>
 #include <cstdint>
 #include <filesystem>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <iterator>
+
+// Counts operator new calls on the current thread, so tests can check that
+// a code path does not allocate.
+thread_local int64_t t_allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++t_allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
 
 // Custom deleter for RAII handling of TensorStore resources
 struct TSContextDeleter {
@@ -38,10 +64,10 @@ protected:
         std::filesystem::remove_all(test_file);
     }
 
-    // Helper to create a basic dataset
-    TSDatasetPtr createTestDataset(const int64_t* shape, int rank) {
+    // Helper to create a basic dataset. The default is an uncompressed zarr v2
+    // array; a positive shard_size_mb creates a sharded zarr v3 array instead.
+    TSDatasetPtr createTestDataset(const int64_t* shape, int rank, int shard_size_mb = 0) {
         const int64_t chunks[] = {32, 32, 32};  // Default chunk size
-        const int shard_size_mb = 8;
 
         TSDataset* dataset = TSCreateZarr(
             context.get(),
@@ -78,6 +104,26 @@ TEST_F(TensorStoreDLLTest, ContextLifecycle) {
     TSDestroyContext(ctx);
 }
 
+// Test context creation with resource limits
+TEST_F(TensorStoreDLLTest, ContextOptions) {
+    TSContextOptions options{};
+    options.cache_pool_bytes = 64 * 1024 * 1024;
+    options.data_copy_concurrency = 2;
+    options.file_io_concurrency = 4;
+    TSContext* ctx = TSCreateContextWithOptions(&options, &error);
+    ASSERT_NE(ctx, nullptr);
+    EXPECT_EQ(error.message, nullptr);
+    TSDestroyContext(ctx);
+
+    ctx = TSCreateContextFromJson(R"({"cache_pool": {"total_bytes_limit": 1048576}})", &error);
+    ASSERT_NE(ctx, nullptr);
+    TSDestroyContext(ctx);
+
+    EXPECT_EQ(TSCreateContextFromJson("not json", &error), nullptr);
+    EXPECT_NE(error.message, nullptr);
+    TSClearError(&error);
+}
+
 // Test dataset creation
 TEST_F(TensorStoreDLLTest, DatasetCreation) {
     const int64_t shape[] = {64, 64, 64};
@@ -165,6 +211,65 @@ TEST_F(TensorStoreDLLTest, ErrorHandling) {
     TSClearError(&error);
 }
 
+// Test errors reported through the thread-local message buffer
+TEST_F(TensorStoreDLLTest, ThreadLocalErrors) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    TSSetErrorMode(TS_ERROR_MODE_THREAD_LOCAL);
+    const int64_t invalid_origin[] = {100, 100, 100};
+    const int64_t read_shape[] = {32, 32, 32};
+    std::vector<uint16_t> data(32 * 32 * 32);
+
+    auto readOutOfBounds = [&](TSError* err) {
+        return TSReadUInt16(dataset.get(), invalid_origin, read_shape, data.data(), err);
+    };
+    ASSERT_EQ(readOutOfBounds(&error), -1);
+    ASSERT_NE(error.message, nullptr);
+    EXPECT_NE(error.code, 0);
+    // The message is formatted on request; until then it is the code name
+    EXPECT_STREQ(error.message, "OUT_OF_RANGE");
+    const std::string first = TSErrorMessage(&error);
+    EXPECT_NE(first.find("is outside [0, 64)"), std::string::npos) << first;
+    EXPECT_EQ(error.message, TSErrorMessage(&error));
+    TSClearError(&error);
+    EXPECT_EQ(error.message, nullptr);
+
+    // Every thread formats into its own buffer
+    std::thread worker([&]() {
+        TSError local{nullptr, 0};
+        EXPECT_EQ(TSGetDataType(nullptr, nullptr, &local), -1);
+        ASSERT_NE(local.message, nullptr);
+        EXPECT_NE(std::string(local.message).find("Invalid arguments"), std::string::npos);
+        TSClearError(&local);
+    });
+    ASSERT_EQ(readOutOfBounds(&error), -1);
+    worker.join();
+    EXPECT_EQ(std::string(TSErrorMessage(&error)), first);
+    TSClearError(&error);
+
+    // The out-of-bounds failure path does not allocate
+    const int64_t before = t_allocations;
+    ASSERT_EQ(readOutOfBounds(&error), -1);
+    EXPECT_EQ(t_allocations, before);
+    EXPECT_EQ(error.code, 11);  // absl::StatusCode::kOutOfRange
+
+    // Errors remember how their message is owned, so switching modes with
+    // errors outstanding neither frees the buffer nor leaks heap messages
+    TSSetErrorMode(TS_ERROR_MODE_HEAP);
+    TSError heap_error{nullptr, 0};
+    ASSERT_EQ(readOutOfBounds(&heap_error), -1);
+    EXPECT_EQ(std::string(heap_error.message), first);
+    TSClearError(&error);
+    EXPECT_EQ(error.message, nullptr);
+    TSSetErrorMode(TS_ERROR_MODE_THREAD_LOCAL);
+    TSClearError(&heap_error);
+    EXPECT_EQ(heap_error.message, nullptr);
+
+    TSSetErrorMode(TS_ERROR_MODE_HEAP);
+}
+
 // Test data type handling
 TEST_F(TensorStoreDLLTest, DataTypeHandling) {
     const int64_t shape[] = {64, 64, 64};
@@ -177,6 +282,207 @@ TEST_F(TensorStoreDLLTest, DataTypeHandling) {
     EXPECT_EQ(dtype, TS_UINT16);
 }
 
+// Test creating, writing and reading the signed and floating point types
+TEST_F(TensorStoreDLLTest, AdditionalDataTypes) {
+    const int64_t shape[] = {16, 16};
+    const int64_t chunks[] = {8, 8};
+    const int64_t origin[] = {0, 0};
+
+    auto roundTrip = [&](TSDataType dtype, const void* values, size_t element_size) {
+        EXPECT_EQ(TSGetDataTypeSize(dtype), element_size);
+        TSDatasetPtr dataset(TSCreateZarr(context.get(), test_file.c_str(), dtype,
+                                          shape, 2, chunks, 1, &error));
+        ASSERT_NE(dataset, nullptr) << "dtype " << dtype;
+
+        TSDataType actual;
+        ASSERT_EQ(TSGetDataType(dataset.get(), &actual, &error), 0);
+        EXPECT_EQ(actual, dtype);
+
+        ASSERT_EQ(TSWrite(dataset.get(), origin, shape, dtype, values, &error), 0);
+        std::vector<char> read_back(16 * 16 * element_size);
+        ASSERT_EQ(TSRead(dataset.get(), origin, shape, dtype, read_back.data(), &error), 0);
+        EXPECT_EQ(std::memcmp(read_back.data(), values, read_back.size()), 0)
+            << "dtype " << dtype;
+    };
+
+    std::vector<float> f32(256);
+    std::vector<double> f64(256);
+    std::vector<int16_t> i16(256);
+    std::vector<int64_t> i64(256);
+    std::vector<uint64_t> u64(256);
+    std::vector<int8_t> i8(256);
+    std::vector<int32_t> i32(256);
+    std::vector<uint16_t> f16(256);  // Raw half precision bit patterns
+    for (int i = 0; i < 256; ++i) {
+        f32[i] = i * 0.25f - 10.0f;
+        f64[i] = i * 1e-3 - 0.1;
+        i16[i] = static_cast<int16_t>(-i * 100);
+        i64[i] = -(static_cast<int64_t>(i) * (int64_t{1} << 40));
+        u64[i] = static_cast<uint64_t>(i) << 50;
+        i8[i] = static_cast<int8_t>(i - 128);
+        i32[i] = -i * 100000;
+        f16[i] = static_cast<uint16_t>(0x3C00 + i);  // 1.0 upwards
+    }
+    roundTrip(TS_FLOAT32, f32.data(), sizeof(float));
+    roundTrip(TS_FLOAT64, f64.data(), sizeof(double));
+    roundTrip(TS_INT16, i16.data(), sizeof(int16_t));
+    roundTrip(TS_INT64, i64.data(), sizeof(int64_t));
+    roundTrip(TS_UINT64, u64.data(), sizeof(uint64_t));
+    roundTrip(TS_INT8, i8.data(), sizeof(int8_t));
+    roundTrip(TS_INT32, i32.data(), sizeof(int32_t));
+    roundTrip(TS_FLOAT16, f16.data(), 2);
+
+    // The typed calls refuse a mismatched element type
+    TSDatasetPtr dataset(TSCreateZarr(context.get(), test_file.c_str(), TS_FLOAT32,
+                                      shape, 2, chunks, 1, &error));
+    ASSERT_NE(dataset, nullptr);
+    EXPECT_NE(TSReadUInt16(dataset.get(), origin, shape, f16.data(), &error), 0);
+    EXPECT_NE(error.message, nullptr);
+    TSClearError(&error);
+}
+
+// Test converting stored uint16 data to float32 during the read
+TEST_F(TensorStoreDLLTest, ReadConvert) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    const int64_t origin[] = {0, 0, 0};
+    const int64_t region[] = {8, 16, 24};
+    const size_t num_elements = 8 * 16 * 24;
+    std::vector<uint16_t> stored(num_elements);
+    for (size_t i = 0; i < num_elements; ++i) {
+        stored[i] = static_cast<uint16_t>(i * 7);
+    }
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, region, stored.data(), &error), 0);
+
+    std::vector<float> converted(num_elements);
+    ASSERT_EQ(TSReadConvert(dataset.get(), origin, region, TS_FLOAT32, converted.data(),
+                            1.0, 0.0, &error), 0);
+    for (size_t i = 0; i < num_elements; ++i) {
+        EXPECT_EQ(converted[i], static_cast<float>(stored[i]));
+    }
+
+    std::vector<double> scaled(num_elements);
+    ASSERT_EQ(TSReadConvert(dataset.get(), origin, region, TS_FLOAT64, scaled.data(),
+                            0.5, -3.0, &error), 0);
+    for (size_t i = 0; i < num_elements; ++i) {
+        EXPECT_DOUBLE_EQ(scaled[i], stored[i] * 0.5 - 3.0);
+    }
+
+    // A region crossing chunk boundaries is scaled one chunk at a time
+    const int64_t span_origin[] = {20, 10, 30};
+    const int64_t span[] = {20, 30, 10};
+    const size_t span_elements = 20 * 30 * 10;
+    std::vector<uint16_t> span_stored(span_elements);
+    for (size_t i = 0; i < span_elements; ++i) {
+        span_stored[i] = static_cast<uint16_t>(i % 1000);
+    }
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), span_origin, span, span_stored.data(), &error), 0);
+    std::vector<float> span_scaled(span_elements);
+    ASSERT_EQ(TSReadConvert(dataset.get(), span_origin, span, TS_FLOAT32, span_scaled.data(),
+                            2.0, 1.0, &error), 0);
+    for (size_t i = 0; i < span_elements; ++i) {
+        ASSERT_EQ(span_scaled[i], span_stored[i] * 2.0f + 1.0f) << "element " << i;
+    }
+
+    // Scale and offset are only defined for floating point output
+    std::vector<int32_t> widened(num_elements);
+    EXPECT_NE(TSReadConvert(dataset.get(), origin, region, TS_INT32, widened.data(),
+                            2.0, 0.0, &error), 0);
+    EXPECT_NE(error.message, nullptr);
+    TSClearError(&error);
+    ASSERT_EQ(TSReadConvert(dataset.get(), origin, region, TS_INT32, widened.data(),
+                            1.0, 0.0, &error), 0);
+    EXPECT_EQ(widened[num_elements - 1], stored[num_elements - 1]);
+}
+
+// Test that shard_size_mb groups chunks into a few shard files
+TEST_F(TensorStoreDLLTest, Sharding) {
+    const int64_t shape[] = {64, 64, 64};
+    const int64_t chunks[] = {16, 16, 16};
+    const int64_t origin[] = {0, 0, 0};
+    std::vector<uint16_t> volume(64 * 64 * 64);
+    for (size_t i = 0; i < volume.size(); ++i) {
+        volume[i] = static_cast<uint16_t>(i % 1000);
+    }
+
+    auto countFiles = [&]() {
+        size_t count = 0;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(test_file)) {
+            if (entry.is_regular_file()) ++count;
+        }
+        return count;
+    };
+
+    for (const char* compressor : {"none", "zstd", "blosc"}) {
+        std::filesystem::remove_all(test_file);
+        TSDatasetPtr dataset(TSCreateZarrCompressed(context.get(), test_file.c_str(), TS_UINT16,
+                                                    shape, 3, chunks, 1, compressor, 3, &error));
+        ASSERT_NE(dataset, nullptr) << compressor;
+        ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, shape, volume.data(), &error), 0);
+
+        std::vector<uint16_t> read_back(volume.size());
+        ASSERT_EQ(TSReadUInt16(dataset.get(), origin, shape, read_back.data(), &error), 0);
+        EXPECT_EQ(read_back, volume) << compressor;
+
+        // Reads still operate on the inner chunks
+        int64_t chunk_shape[3];
+        int chunk_rank;
+        ASSERT_EQ(TSGetChunkShape(dataset.get(), chunk_shape, &chunk_rank, &error), 0);
+        EXPECT_EQ(chunk_shape[0], 16);
+
+        // 64 chunks of 8 KiB fit in one 1 MiB shard plus the array metadata
+        EXPECT_LE(countFiles(), 2u) << compressor;
+    }
+
+    // Without sharding every chunk is its own file
+    std::filesystem::remove_all(test_file);
+    TSDatasetPtr unsharded(TSCreateZarr(context.get(), test_file.c_str(), TS_UINT16,
+                                        shape, 3, chunks, 0, &error));
+    ASSERT_NE(unsharded, nullptr);
+    ASSERT_EQ(TSWriteUInt16(unsharded.get(), origin, shape, volume.data(), &error), 0);
+    EXPECT_GE(countFiles(), 64u);
+}
+
+// Test codec selection from sample data
+TEST_F(TensorStoreDLLTest, RecommendCompression) {
+    const int64_t shape[] = {32, 32, 32};
+    std::vector<uint16_t> sample(32 * 32 * 32);
+    for (size_t i = 0; i < sample.size(); ++i) {
+        sample[i] = static_cast<uint16_t>((i / 64) % 100);
+    }
+
+    TSCompressionConfig config;
+    EXPECT_EQ(TSRecommendCompression(context.get(), sample.data(), TS_UINT16, shape, 0,
+                                     TS_COMPRESSION_GOAL_RATIO, &config, &error), -1);
+    TSClearError(&error);
+
+    TSCompressionConfig densest;
+    ASSERT_EQ(TSRecommendCompression(context.get(), sample.data(), TS_UINT16, shape, 3,
+                                     TS_COMPRESSION_GOAL_RATIO, &densest, &error), 0)
+        << error.message;
+    EXPECT_NE(std::string(densest.compressor), "none");
+    EXPECT_GT(densest.ratio, 2.0);
+    for (TSCompressionGoal goal : {TS_COMPRESSION_GOAL_WRITE_THROUGHPUT,
+                                   TS_COMPRESSION_GOAL_READ_THROUGHPUT}) {
+        ASSERT_EQ(TSRecommendCompression(context.get(), sample.data(), TS_UINT16, shape, 3, goal,
+                                         &config, &error), 0);
+        EXPECT_GT(config.ratio, 1.0);
+        EXPECT_LE(config.ratio, densest.ratio);
+    }
+
+    // The recommendation creates a dataset that round-trips the sample
+    TSDatasetPtr dataset(TSCreateZarrWithConfig(context.get(), test_file.c_str(), TS_UINT16,
+                                                shape, 3, shape, 0, &densest, &error));
+    ASSERT_NE(dataset, nullptr);
+    const int64_t origin[] = {0, 0, 0};
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, shape, sample.data(), &error), 0);
+    std::vector<uint16_t> read_back(sample.size());
+    ASSERT_EQ(TSReadUInt16(dataset.get(), origin, shape, read_back.data(), &error), 0);
+    EXPECT_EQ(read_back, sample);
+}
+
 // Test chunk shape retrieval
 TEST_F(TensorStoreDLLTest, ChunkShape) {
     const int64_t shape[] = {64, 64, 64};
@@ -193,6 +499,456 @@ TEST_F(TensorStoreDLLTest, ChunkShape) {
     }
 }
 
+// Test that writes large enough to be split across chunk slabs round-trip
+TEST_F(TensorStoreDLLTest, LargeWrite) {
+    const int64_t shape[] = {320, 128, 256};
+    auto dataset = createTestDataset(shape, 3, /*shard_size_mb=*/8);
+    ASSERT_NE(dataset, nullptr);
+
+    // Unaligned origin so the first and last slabs are partial
+    const int64_t origin[] = {5, 0, 0};
+    const int64_t region[] = {300, 128, 256};
+    std::vector<uint16_t> data(300 * 128 * 256);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint16_t>(i * 7);
+    }
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, region, data.data(), &error), 0);
+
+    std::vector<uint16_t> read_back(data.size());
+    ASSERT_EQ(TSReadUInt16(dataset.get(), origin, region, read_back.data(), &error), 0);
+    EXPECT_EQ(read_back, data);
+
+    // Outside the written region the fill value is untouched
+    const int64_t head_origin[] = {0, 0, 0};
+    const int64_t head_shape[] = {5, 128, 256};
+    std::vector<uint16_t> head(5 * 128 * 256, 1);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), head_origin, head_shape, head.data(), &error), 0);
+    EXPECT_TRUE(std::all_of(head.begin(), head.end(), [](uint16_t v) { return v == 0; }));
+}
+
+// Test plane-by-plane reads with read-ahead enabled
+TEST_F(TensorStoreDLLTest, Prefetch) {
+    TSContextOptions options{64 << 20, 0, 0};
+    context.reset(TSCreateContextWithOptions(&options, &error));
+    ASSERT_NE(context, nullptr);
+
+    const int64_t shape[] = {128, 64, 64};
+    auto dataset = createTestDataset(shape, 3, /*shard_size_mb=*/8);
+    ASSERT_NE(dataset, nullptr);
+
+    std::vector<uint16_t> volume(128 * 64 * 64);
+    for (size_t i = 0; i < volume.size(); ++i) {
+        volume[i] = static_cast<uint16_t>(i / (64 * 64));
+    }
+    const int64_t origin[] = {0, 0, 0};
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, shape, volume.data(), &error), 0);
+
+    EXPECT_EQ(TSSetPrefetch(dataset.get(), 3, 2, &error), -1);
+    TSClearError(&error);
+    ASSERT_EQ(TSSetPrefetch(dataset.get(), 0, 2, &error), 0);
+
+    const int64_t plane_shape[] = {1, 64, 64};
+    std::vector<uint16_t> plane(64 * 64);
+    for (int64_t z = 0; z < 128; ++z) {
+        const int64_t plane_origin[] = {z, 0, 0};
+        ASSERT_EQ(TSReadUInt16(dataset.get(), plane_origin, plane_shape, plane.data(), &error), 0);
+        EXPECT_TRUE(std::all_of(plane.begin(), plane.end(),
+                                [z](uint16_t v) { return v == static_cast<uint16_t>(z); }))
+            << "plane " << z;
+    }
+
+    // The first sequential read loads chunk layers 1 and 2 ahead of it, and
+    // crossing into layer 1 loads layer 3; each layer holds 2x2 chunks
+    std::vector<char> json(1 << 20);
+    int64_t prefetched = 0;
+    for (int i = 0; i < 1000 && prefetched < 12; ++i) {
+        ASSERT_EQ(TSGetMetrics(context.get(), json.data(), json.size(), &error), 0);
+        prefetched = nlohmann::json::parse(json.data())["prefetched_chunks"].get<int64_t>();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(prefetched, 12);
+
+    // Closing with read-ahead still in flight is safe
+    const int64_t jump_origin[] = {10, 0, 0};
+    const int64_t next_origin[] = {11, 0, 0};
+    ASSERT_EQ(TSReadUInt16(dataset.get(), jump_origin, plane_shape, plane.data(), &error), 0);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), next_origin, plane_shape, plane.data(), &error), 0);
+    EXPECT_EQ(TSSetPrefetch(dataset.get(), 0, 0, &error), 0);
+}
+
+// Test reopening existing datasets
+TEST_F(TensorStoreDLLTest, OpenDataset) {
+    const int64_t shape[] = {64, 64, 64};
+    const int64_t chunks[] = {32, 32, 32};
+    const int64_t origin[] = {0, 0, 0};
+    std::vector<uint16_t> data(64 * 64 * 64);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint16_t>(i % 4099);
+    }
+
+    EXPECT_EQ(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ, &error), nullptr);
+    EXPECT_NE(error.message, nullptr);
+    TSClearError(&error);
+
+    for (int shard_size_mb : {0, 8}) {
+        {
+            TSDatasetPtr created(TSCreateZarr(context.get(), test_file.c_str(), TS_UINT16,
+                                              shape, 3, chunks, shard_size_mb, &error));
+            ASSERT_NE(created, nullptr);
+            ASSERT_EQ(TSWriteUInt16(created.get(), origin, shape, data.data(), &error), 0);
+        }
+
+        TSDatasetPtr reader(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ, &error));
+        ASSERT_NE(reader, nullptr) << "shard_size_mb " << shard_size_mb;
+        TSDataType dtype;
+        ASSERT_EQ(TSGetDataType(reader.get(), &dtype, &error), 0);
+        EXPECT_EQ(dtype, TS_UINT16);
+        int64_t read_shape[3];
+        int rank;
+        ASSERT_EQ(TSGetShape(reader.get(), read_shape, &rank, &error), 0);
+        EXPECT_EQ(rank, 3);
+        EXPECT_EQ(read_shape[0], 64);
+
+        std::vector<uint16_t> read_back(data.size());
+        ASSERT_EQ(TSReadUInt16(reader.get(), origin, shape, read_back.data(), &error), 0);
+        EXPECT_EQ(read_back, data);
+
+        // Read-only handles reject writes
+        EXPECT_EQ(TSWriteUInt16(reader.get(), origin, shape, data.data(), &error), -1);
+        TSClearError(&error);
+
+        TSDatasetPtr writer(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ_WRITE,
+                                       &error));
+        ASSERT_NE(writer, nullptr);
+        EXPECT_EQ(TSWriteUInt16(writer.get(), origin, shape, data.data(), &error), 0);
+    }
+
+    // Concurrent reopening shares the cached array
+    std::vector<std::thread> workers;
+    std::atomic<int> opened{0};
+    for (int t = 0; t < 8; ++t) {
+        workers.emplace_back([&]() {
+            for (int i = 0; i < 100; ++i) {
+                TSError local{nullptr, 0};
+                TSDataset* ds = TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ, &local);
+                if (ds) ++opened;
+                TSCloseDataset(ds);
+                TSClearError(&local);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    EXPECT_EQ(opened.load(), 800);
+}
+
+// Test batched and JSON metadata updates
+TEST_F(TensorStoreDLLTest, MetadataBatch) {
+    const int64_t shape[] = {64, 64, 64};
+    for (int shard_size_mb : {0, 8}) {
+        const int64_t chunks[] = {32, 32, 32};
+        TSDatasetPtr dataset(TSCreateZarr(context.get(), test_file.c_str(), TS_UINT16, shape, 3,
+                                          chunks, shard_size_mb, &error));
+        ASSERT_NE(dataset, nullptr);
+        TSDatasetPtr other(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ, &error));
+        ASSERT_NE(other, nullptr);
+        ASSERT_EQ(TSSetMetadataCheckMtime(other.get(), 1, &error), 0);
+
+        ASSERT_EQ(TSBeginMetadataBatch(dataset.get(), &error), 0);
+        EXPECT_EQ(TSBeginMetadataBatch(dataset.get(), &error), -1);
+        TSClearError(&error);
+        ASSERT_EQ(TSSetMetadata(dataset.get(), "title", "batch", &error), 0);
+        ASSERT_EQ(TSSetMetadataJSON(dataset.get(), R"({"scale": 0.5, "units": "um"})", &error), 0);
+
+        // Staged values are visible on this handle only
+        char value[64];
+        ASSERT_EQ(TSGetMetadata(dataset.get(), "title", value, sizeof(value), &error), 0);
+        EXPECT_STREQ(value, "batch");
+        EXPECT_EQ(TSGetMetadata(other.get(), "title", value, sizeof(value), &error), -1);
+        TSClearError(&error);
+
+        ASSERT_EQ(TSCommitMetadataBatch(dataset.get(), &error), 0);
+        EXPECT_EQ(TSCommitMetadataBatch(dataset.get(), &error), -1);
+        TSClearError(&error);
+
+        ASSERT_EQ(TSGetMetadata(other.get(), "title", value, sizeof(value), &error), 0);
+        EXPECT_STREQ(value, "batch");
+        ASSERT_EQ(TSGetMetadata(other.get(), "scale", value, sizeof(value), &error), 0);
+        EXPECT_STREQ(value, "0.5");
+        EXPECT_EQ(TSGetMetadata(other.get(), "title", value, 3, &error), -1);
+        TSClearError(&error);
+
+        // A null key array queries the count; a short one is refused
+        size_t num_keys = 0;
+        ASSERT_EQ(TSListMetadata(other.get(), nullptr, &num_keys, &error), 0);
+        ASSERT_EQ(num_keys, 3u);
+        char* keys[8];
+        num_keys = 2;
+        EXPECT_EQ(TSListMetadata(other.get(), keys, &num_keys, &error), -1);
+        EXPECT_EQ(num_keys, 3u);
+        TSClearError(&error);
+        num_keys = 8;
+        ASSERT_EQ(TSListMetadata(other.get(), keys, &num_keys, &error), 0);
+        ASSERT_EQ(num_keys, 3u);
+        std::vector<std::string> names(keys, keys + num_keys);
+        std::sort(names.begin(), names.end());
+        EXPECT_EQ(names, (std::vector<std::string>{"scale", "title", "units"}));
+
+        EXPECT_EQ(TSSetMetadataJSON(dataset.get(), "[1, 2]", &error), -1);
+        TSClearError(&error);
+
+        // Zarr v3 attributes are patched into zarr.json outside tensorstore;
+        // reopening the array in a fresh context picks up both the array
+        // metadata and the new attributes
+        dataset.reset();
+        other.reset();
+        TSContextPtr fresh(TSCreateContext());
+        TSDatasetPtr reopened(TSOpenZarr(fresh.get(), test_file.c_str(), TS_OPEN_READ_WRITE,
+                                         &error));
+        ASSERT_NE(reopened, nullptr) << "shard_size_mb " << shard_size_mb;
+        int64_t reopened_shape[3];
+        int rank = 0;
+        ASSERT_EQ(TSGetShape(reopened.get(), reopened_shape, &rank, &error), 0);
+        EXPECT_EQ(rank, 3);
+        EXPECT_EQ(reopened_shape[0], 64);
+        ASSERT_EQ(TSGetMetadata(reopened.get(), "units", value, sizeof(value), &error), 0);
+        EXPECT_STREQ(value, "um");
+        const int64_t origin[] = {0, 0, 0};
+        const int64_t region[] = {1, 1, 1};
+        uint16_t element = 9;
+        EXPECT_EQ(TSWriteUInt16(reopened.get(), origin, region, &element, &error), 0);
+    }
+}
+
+// Test that cached attributes follow updates made through other handles
+TEST_F(TensorStoreDLLTest, MetadataCache) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+    TSDatasetPtr other(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ_WRITE, &error));
+    ASSERT_NE(other, nullptr);
+
+    ASSERT_EQ(TSSetMetadata(dataset.get(), "state", "old", &error), 0);
+    char value[64];
+    ASSERT_EQ(TSGetMetadata(other.get(), "state", value, sizeof(value), &error), 0);
+    EXPECT_STREQ(value, "old");
+
+    // By default the handle keeps serving its cached copy
+    ASSERT_EQ(TSSetMetadata(dataset.get(), "state", "updated", &error), 0);
+    ASSERT_EQ(TSGetMetadata(other.get(), "state", value, sizeof(value), &error), 0);
+    EXPECT_STREQ(value, "old");
+
+    // With the mtime check it follows the file
+    ASSERT_EQ(TSSetMetadataCheckMtime(other.get(), 1, &error), 0);
+    ASSERT_EQ(TSGetMetadata(other.get(), "state", value, sizeof(value), &error), 0);
+    EXPECT_STREQ(value, "updated");
+    ASSERT_EQ(TSSetMetadata(dataset.get(), "state", "again", &error), 0);
+    ASSERT_EQ(TSGetMetadata(other.get(), "state", value, sizeof(value), &error), 0);
+    EXPECT_STREQ(value, "again");
+
+    // Switching it back off freezes the copy again
+    ASSERT_EQ(TSSetMetadataCheckMtime(other.get(), 0, &error), 0);
+    ASSERT_EQ(TSSetMetadata(dataset.get(), "state", "hidden", &error), 0);
+    ASSERT_EQ(TSGetMetadata(other.get(), "state", value, sizeof(value), &error), 0);
+    EXPECT_STREQ(value, "again");
+    ASSERT_EQ(TSSetMetadataCheckMtime(other.get(), 1, &error), 0);
+
+    // Repeated lookups of many keys stay consistent
+    std::string json = "{";
+    for (int i = 0; i < 100; ++i) {
+        json += (i ? ",\"key" : "\"key") + std::to_string(i) + "\":\"" + std::to_string(i) + "\"";
+    }
+    json += "}";
+    ASSERT_EQ(TSSetMetadataJSON(dataset.get(), json.c_str(), &error), 0);
+    for (int i = 0; i < 100; ++i) {
+        const std::string key = "key" + std::to_string(i);
+        ASSERT_EQ(TSGetMetadata(other.get(), key.c_str(), value, sizeof(value), &error), 0);
+        EXPECT_EQ(std::string(value), std::to_string(i));
+    }
+}
+
+// Test OME-Zarr pyramid generation next to a base array
+TEST_F(TensorStoreDLLTest, BuildPyramid) {
+    const int64_t shape[] = {64, 64, 64};
+    const int64_t chunks[] = {16, 16, 16};
+    const int64_t origin[] = {0, 0, 0};
+    const std::string base = test_file + "/0";
+
+    // Even x holds 10, odd x holds 30, so every 2x2x2 block averages to 20
+    std::vector<uint16_t> data(64 * 64 * 64);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (i % 2) ? 30 : 10;
+    }
+
+    for (int shard_size_mb : {0, 1}) {
+        std::filesystem::remove_all(test_file);
+        TSDatasetPtr dataset(TSCreateZarr(context.get(), base.c_str(), TS_UINT16, shape, 3,
+                                          chunks, shard_size_mb, &error));
+        ASSERT_NE(dataset, nullptr);
+        // The base is only staged; the pyramid must see it anyway
+        ASSERT_EQ(TSSetWriteBackCache(dataset.get(), int64_t{64} << 20, &error), 0);
+        ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, shape, data.data(), &error), 0);
+
+        EXPECT_EQ(TSBuildPyramid(dataset.get(), 0, TS_DOWNSAMPLE_MEAN, &error), -1);
+        TSClearError(&error);
+        ASSERT_EQ(TSBuildPyramid(dataset.get(), 2, TS_DOWNSAMPLE_MEAN, &error), 0)
+            << error.message;
+
+        for (int level = 1; level <= 2; ++level) {
+            const std::string level_path = test_file + "/" + std::to_string(level);
+            TSDatasetPtr scaled(TSOpenZarr(context.get(), level_path.c_str(), TS_OPEN_READ,
+                                           &error));
+            ASSERT_NE(scaled, nullptr) << level_path;
+            int64_t level_shape[3];
+            int rank;
+            ASSERT_EQ(TSGetShape(scaled.get(), level_shape, &rank, &error), 0);
+            EXPECT_EQ(level_shape[0], 64 >> level);
+            EXPECT_EQ(level_shape[2], 64 >> level);
+
+            std::vector<uint16_t> values(level_shape[0] * level_shape[1] * level_shape[2]);
+            ASSERT_EQ(TSReadUInt16(scaled.get(), origin, level_shape, values.data(), &error), 0);
+            EXPECT_TRUE(std::all_of(values.begin(), values.end(),
+                                    [](uint16_t v) { return v == 20; }));
+        }
+
+        const std::string group_file =
+            test_file + (shard_size_mb > 0 ? "/zarr.json" : "/.zattrs");
+        std::ifstream group(group_file);
+        ASSERT_TRUE(group.good()) << group_file;
+        const std::string attributes((std::istreambuf_iterator<char>(group)),
+                                     std::istreambuf_iterator<char>());
+        EXPECT_NE(attributes.find("multiscales"), std::string::npos);
+    }
+
+    // A bare relative base has no group directory; the working directory is
+    // left alone
+    std::filesystem::remove_all(test_file);
+    const bool had_zattrs = std::filesystem::exists(".zattrs");
+    const bool had_zgroup = std::filesystem::exists(".zgroup");
+    {
+        TSDatasetPtr bare(TSCreateZarr(context.get(), test_file.c_str(), TS_UINT16, shape, 3,
+                                       chunks, 0, &error));
+        ASSERT_NE(bare, nullptr);
+        EXPECT_EQ(TSBuildPyramid(bare.get(), 1, TS_DOWNSAMPLE_MEAN, &error), -1);
+        EXPECT_NE(error.message, nullptr);
+        TSClearError(&error);
+    }
+    EXPECT_EQ(std::filesystem::exists(".zattrs"), had_zattrs);
+    EXPECT_EQ(std::filesystem::exists(".zgroup"), had_zgroup);
+    EXPECT_FALSE(std::filesystem::exists(test_file + "_1"));
+
+    // With explicit axes only the spatial dimensions of a (t, y, x) series
+    // are halved
+    std::filesystem::remove_all(test_file);
+    const int64_t series_shape[] = {6, 64, 64};
+    TSDatasetPtr series(TSCreateZarr(context.get(), base.c_str(), TS_UINT16, series_shape, 3,
+                                     chunks, 0, &error));
+    ASSERT_NE(series, nullptr);
+    EXPECT_EQ(TSBuildPyramidWithAxes(series.get(), 1, TS_DOWNSAMPLE_MEAN, "tyxz", &error), -1);
+    TSClearError(&error);
+    EXPECT_EQ(TSBuildPyramidWithAxes(series.get(), 1, TS_DOWNSAMPLE_MEAN, "tct", &error), -1);
+    TSClearError(&error);
+    ASSERT_EQ(TSBuildPyramidWithAxes(series.get(), 1, TS_DOWNSAMPLE_MEAN, "tyx", &error), 0)
+        << error.message;
+    TSDatasetPtr series_level(TSOpenZarr(context.get(), (test_file + "/1").c_str(),
+                                         TS_OPEN_READ, &error));
+    ASSERT_NE(series_level, nullptr);
+    int64_t series_level_shape[3];
+    int series_rank;
+    ASSERT_EQ(TSGetShape(series_level.get(), series_level_shape, &series_rank, &error), 0);
+    EXPECT_EQ(series_level_shape[0], 6);
+    EXPECT_EQ(series_level_shape[1], 32);
+    EXPECT_EQ(series_level_shape[2], 32);
+}
+
+// Test row-by-row writes through the write-back cache
+TEST_F(TensorStoreDLLTest, WriteBackCache) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    EXPECT_EQ(TSSetWriteBackCache(dataset.get(), -1, &error), -1);
+    TSClearError(&error);
+    // Room for two 32^3 uint16 chunks, so the writes below spill several times
+    ASSERT_EQ(TSSetWriteBackCache(dataset.get(), 2 * 32 * 32 * 32 * 2, &error), 0);
+
+    const int64_t row_shape[] = {1, 1, 64};
+    std::vector<uint16_t> row(64);
+    for (int64_t z = 0; z < 64; ++z) {
+        for (int64_t y = 0; y < 64; ++y) {
+            std::fill(row.begin(), row.end(), static_cast<uint16_t>(z * 64 + y));
+            const int64_t row_origin[] = {z, y, 0};
+            ASSERT_EQ(TSWriteUInt16(dataset.get(), row_origin, row_shape, row.data(), &error), 0);
+        }
+    }
+
+    // Buffered rows are visible through the same handle before the flush
+    const int64_t origin[] = {0, 0, 0};
+    std::vector<uint16_t> volume(64 * 64 * 64);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), origin, shape, volume.data(), &error), 0);
+    for (size_t i = 0; i < volume.size(); i += 64) {
+        ASSERT_EQ(volume[i], static_cast<uint16_t>(i / 64)) << "row " << i / 64;
+    }
+
+    ASSERT_EQ(TSFlush(dataset.get(), &error), 0);
+    TSDatasetPtr reader(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ, &error));
+    ASSERT_NE(reader, nullptr);
+    std::fill(volume.begin(), volume.end(), 0);
+    ASSERT_EQ(TSReadUInt16(reader.get(), origin, shape, volume.data(), &error), 0);
+    for (size_t i = 0; i < volume.size(); ++i) {
+        ASSERT_EQ(volume[i], static_cast<uint16_t>(i / 64)) << "element " << i;
+    }
+
+    ASSERT_EQ(TSSetWriteBackCache(dataset.get(), 0, &error), 0);
+}
+
+// Test concurrent writers against a write-back budget they keep exceeding
+TEST_F(TensorStoreDLLTest, WriteBackConcurrentWriters) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+    // Room for one 32^3 uint16 chunk, so most writes start a commit
+    ASSERT_EQ(TSSetWriteBackCache(dataset.get(), 32 * 32 * 32 * 2, &error), 0);
+
+    // Each thread owns a quarter of the rows along dimension 1, so every
+    // chunk is shared by two threads
+    constexpr int kThreads = 4;
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            TSError thread_error = {};
+            const int64_t row_shape[] = {1, 1, 64};
+            std::vector<uint16_t> row(64);
+            for (int64_t z = 0; z < 64; ++z) {
+                for (int64_t y = t * 16; y < (t + 1) * 16; ++y) {
+                    std::fill(row.begin(), row.end(), static_cast<uint16_t>(z * 64 + y));
+                    const int64_t row_origin[] = {z, y, 0};
+                    if (TSWriteUInt16(dataset.get(), row_origin, row_shape, row.data(),
+                                      &thread_error) != 0) {
+                        ++failures;
+                        TSClearError(&thread_error);
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(failures.load(), 0);
+    ASSERT_EQ(TSFlush(dataset.get(), &error), 0);
+
+    TSDatasetPtr reader(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ, &error));
+    ASSERT_NE(reader, nullptr);
+    const int64_t origin[] = {0, 0, 0};
+    std::vector<uint16_t> volume(64 * 64 * 64);
+    ASSERT_EQ(TSReadUInt16(reader.get(), origin, shape, volume.data(), &error), 0);
+    for (size_t i = 0; i < volume.size(); ++i) {
+        ASSERT_EQ(volume[i], static_cast<uint16_t>(i / 64)) << "element " << i;
+    }
+    ASSERT_EQ(TSSetWriteBackCache(dataset.get(), 0, &error), 0);
+}
+
 // Test partial reads and writes
 TEST_F(TensorStoreDLLTest, PartialIO) {
     const int64_t shape[] = {64, 64, 64};
@@ -221,6 +977,502 @@ TEST_F(TensorStoreDLLTest, PartialIO) {
     }
 }
 
+// Test asynchronous writes and reads with several operations in flight
+TEST_F(TensorStoreDLLTest, AsyncIO) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    const int64_t chunk_shape[] = {32, 32, 32};
+    const size_t num_elements = 32 * 32 * 32;
+    const int64_t origins[][3] = {
+        {0, 0, 0}, {0, 0, 32}, {0, 32, 0}, {32, 0, 0}
+    };
+
+    std::vector<std::vector<uint16_t>> write_data;
+    std::vector<TSFuture*> futures;
+    for (size_t c = 0; c < 4; ++c) {
+        write_data.emplace_back(num_elements, static_cast<uint16_t>(c + 1));
+        TSFuture* future = TSWriteAsync(dataset.get(), origins[c], chunk_shape,
+                                        write_data.back().data(), &error);
+        ASSERT_NE(future, nullptr);
+        futures.push_back(future);
+    }
+    for (TSFuture* future : futures) {
+        EXPECT_EQ(TSFutureWait(future, -1, &error), 0);
+        EXPECT_EQ(error.message, nullptr);
+        EXPECT_EQ(TSFutureIsReady(future), 1);
+        TSDestroyFuture(future);
+    }
+
+    std::vector<uint16_t> read_data(num_elements);
+    TSFuture* read = TSReadAsync(dataset.get(), origins[2], chunk_shape,
+                                 read_data.data(), &error);
+    ASSERT_NE(read, nullptr);
+
+    std::atomic<int> callback_code{-1};
+    ASSERT_EQ(TSFutureSetCallback(read, [](void* user_data, int code) {
+        static_cast<std::atomic<int>*>(user_data)->store(code);
+    }, &callback_code, &error), 0);
+
+    EXPECT_EQ(TSFutureWait(read, 10000, &error), 0);
+    EXPECT_EQ(error.message, nullptr);
+    TSDestroyFuture(read);
+    EXPECT_EQ(read_data, write_data[2]);
+
+    // Callbacks may still be running on a worker thread after the wait returns
+    for (int i = 0; i < 1000 && callback_code.load() != 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(callback_code.load(), 0);
+}
+
+// Test streaming frames along the outermost dimension
+TEST_F(TensorStoreDLLTest, StreamWriter) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    // Start mid-chunk and stop before the end to exercise partial slabs
+    const int64_t start_frame = 5;
+    const int64_t num_frames = 40;
+    const size_t frame_elements = 64 * 64;
+
+    TSStreamWriter* writer = TSCreateStreamWriter(dataset.get(), start_frame, 2, &error);
+    ASSERT_NE(writer, nullptr);
+    std::vector<uint16_t> frame(frame_elements);
+    for (int64_t f = 0; f < num_frames; ++f) {
+        std::fill(frame.begin(), frame.end(), static_cast<uint16_t>(start_frame + f));
+        ASSERT_EQ(TSStreamWriterAppend(writer, frame.data(), &error), 0);
+    }
+    EXPECT_EQ(TSStreamWriterGetFrameCount(writer), num_frames);
+    ASSERT_EQ(TSDestroyStreamWriter(writer, &error), 0);
+    EXPECT_EQ(error.message, nullptr);
+
+    const int64_t read_origin[] = {start_frame, 0, 0};
+    const int64_t read_shape[] = {num_frames, 64, 64};
+    std::vector<uint16_t> read_data(num_frames * frame_elements);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), read_origin, read_shape,
+                          read_data.data(), &error), 0);
+    for (int64_t f = 0; f < num_frames; ++f) {
+        EXPECT_EQ(read_data[f * frame_elements], start_frame + f);
+        EXPECT_EQ(read_data[(f + 1) * frame_elements - 1], start_frame + f);
+    }
+
+    // Appending past the end of the dataset fails
+    writer = TSCreateStreamWriter(dataset.get(), shape[0], 0, &error);
+    ASSERT_NE(writer, nullptr);
+    EXPECT_NE(TSStreamWriterAppend(writer, frame.data(), &error), 0);
+    EXPECT_NE(error.message, nullptr);
+    TSClearError(&error);
+    EXPECT_EQ(TSDestroyStreamWriter(writer, &error), 0);
+}
+
+// Test reuse of stream writer slabs and chunk view buffers through the
+// context's scratch pool
+TEST_F(TensorStoreDLLTest, ScratchPoolReuse) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    auto pool_counters = [&] {
+        std::vector<char> json(1 << 16);
+        EXPECT_EQ(TSGetMetrics(context.get(), json.data(), json.size(), &error), 0);
+        return nlohmann::json::parse(json.data())["scratch_pool"];
+    };
+
+    std::vector<uint16_t> frame(64 * 64, 3);
+    for (int pass = 0; pass < 3; ++pass) {
+        TSStreamWriter* writer = TSCreateStreamWriter(dataset.get(), pass, 2, &error);
+        ASSERT_NE(writer, nullptr);
+        for (int f = 0; f < 8; ++f) {
+            ASSERT_EQ(TSStreamWriterAppend(writer, frame.data(), &error), 0);
+        }
+        ASSERT_EQ(TSDestroyStreamWriter(writer, &error), 0);
+    }
+
+    // Later passes take their slab from the pool instead of allocating,
+    // unless tensorstore still held an earlier slab when they started
+    auto counters = pool_counters();
+    const int64_t allocated = counters["allocated"].get<int64_t>();
+    const int64_t reused = counters["reused"].get<int64_t>();
+    EXPECT_GE(reused, 1) << counters;
+    EXPECT_EQ(allocated + reused, 3) << counters;
+
+    // Views of compressed chunks are decoded into pool buffers, so each
+    // released view's buffer serves the next one
+    dataset.reset();
+    std::filesystem::remove_all(test_file);
+    const int64_t chunks[] = {32, 32, 32};
+    dataset.reset(TSCreateZarrCompressed(context.get(), test_file.c_str(), TS_UINT16, shape, 3,
+                                         chunks, 0, "zstd", 3, &error));
+    ASSERT_NE(dataset, nullptr);
+    std::vector<uint16_t> volume(64 * 64 * 64, 7);
+    const int64_t origin[] = {0, 0, 0};
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, shape, volume.data(), &error), 0);
+    for (int64_t z = 0; z < 64; z += 32) {
+        for (int64_t y = 0; y < 64; y += 32) {
+            for (int64_t x = 0; x < 64; x += 32) {
+                const int64_t chunk_origin[] = {z, y, x};
+                const void* data = nullptr;
+                int64_t byte_strides[3];
+                TSChunkView* view = TSReadChunkView(dataset.get(), chunk_origin, chunks, &data,
+                                                    byte_strides, &error);
+                ASSERT_NE(view, nullptr) << error.message;
+                EXPECT_EQ(static_cast<const uint16_t*>(data)[0], 7);
+                EXPECT_EQ(TSChunkViewIsZeroCopy(view), 0);
+                TSReleaseChunkView(view);
+            }
+        }
+    }
+    counters = pool_counters();
+    EXPECT_EQ(counters["allocated"].get<int64_t>(), allocated + 1) << counters;
+    EXPECT_EQ(counters["reused"].get<int64_t>(), reused + 7) << counters;
+}
+
+// Test batched reads of tiles that share chunks
+TEST_F(TensorStoreDLLTest, ReadBatch) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    const size_t num_elements = 64 * 64 * 64;
+    std::vector<uint16_t> volume(num_elements);
+    for (size_t i = 0; i < num_elements; ++i) {
+        volume[i] = static_cast<uint16_t>(i % 65536);
+    }
+    const int64_t origin[] = {0, 0, 0};
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, shape, volume.data(), &error), 0);
+
+    const int64_t tile_shape[] = {1, 16, 16};
+    const int64_t tile_origins[][3] = {
+        {0, 0, 0}, {0, 0, 16}, {0, 16, 0}, {10, 24, 24}, {40, 48, 8}
+    };
+    std::vector<std::vector<uint16_t>> tiles(5, std::vector<uint16_t>(16 * 16));
+    std::vector<TSRegion> regions;
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        regions.push_back({tile_origins[t], tile_shape, tiles[t].data()});
+    }
+    ASSERT_EQ(TSReadBatch(dataset.get(), regions.data(), regions.size(), &error), 0);
+    EXPECT_EQ(error.message, nullptr);
+
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        const int64_t* o = tile_origins[t];
+        for (int64_t y = 0; y < 16; ++y) {
+            for (int64_t x = 0; x < 16; ++x) {
+                EXPECT_EQ(tiles[t][y * 16 + x],
+                          volume[(o[0] * 64 + o[1] + y) * 64 + o[2] + x]);
+            }
+        }
+    }
+
+    // A region outside the dataset fails the batch
+    const int64_t bad_origin[] = {100, 0, 0};
+    regions.push_back({bad_origin, tile_shape, tiles[0].data()});
+    EXPECT_NE(TSReadBatch(dataset.get(), regions.data(), regions.size(), &error), 0);
+    EXPECT_NE(error.message, nullptr);
+    TSClearError(&error);
+}
+
+// Test borrowing a chunk-aligned region without copying into a caller buffer
+TEST_F(TensorStoreDLLTest, ChunkView) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    const int64_t chunk_origin[] = {32, 0, 32};
+    const int64_t chunk_shape[] = {32, 32, 32};
+    std::vector<uint16_t> write_data(32 * 32 * 32);
+    for (size_t i = 0; i < write_data.size(); ++i) {
+        write_data[i] = static_cast<uint16_t>(i);
+    }
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), chunk_origin, chunk_shape,
+                           write_data.data(), &error), 0);
+
+    const void* data = nullptr;
+    int64_t byte_strides[3];
+    TSChunkView* view = TSReadChunkView(dataset.get(), chunk_origin, chunk_shape,
+                                        &data, byte_strides, &error);
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(error.message, nullptr);
+    const char* bytes = static_cast<const char*>(data);
+    for (int64_t z = 0; z < 32; z += 7) {
+        for (int64_t y = 0; y < 32; y += 5) {
+            for (int64_t x = 0; x < 32; x += 3) {
+                uint16_t value;
+                std::memcpy(&value, bytes + z * byte_strides[0] + y * byte_strides[1] +
+                                        x * byte_strides[2], sizeof(value));
+                EXPECT_EQ(value, write_data[(z * 32 + y) * 32 + x]);
+            }
+        }
+    }
+#ifndef _WIN32
+    // Uncompressed chunks are lent from the mapped chunk file
+    EXPECT_EQ(TSChunkViewIsZeroCopy(view), 1);
+#endif
+    TSReleaseChunkView(view);
+
+    // Regions that straddle chunks are rejected
+    const int64_t unaligned_origin[] = {16, 0, 0};
+    EXPECT_EQ(TSReadChunkView(dataset.get(), unaligned_origin, chunk_shape,
+                              &data, byte_strides, &error), nullptr);
+    EXPECT_NE(error.message, nullptr);
+    TSClearError(&error);
+}
+
+// Test reads of uncompressed chunks through mapped chunk files
+TEST_F(TensorStoreDLLTest, MappedReads) {
+    const int64_t shape[] = {64, 64, 64};
+    const int64_t chunks[] = {16, 16, 16};
+    TSDatasetPtr dataset(TSCreateZarr(context.get(), test_file.c_str(), TS_UINT16, shape, 3,
+                                      chunks, 0, &error));
+    ASSERT_NE(dataset, nullptr);
+
+    // Only the lower half is written; the rest reads as the fill value
+    const int64_t origin[] = {0, 0, 0};
+    const int64_t half_shape[] = {32, 64, 64};
+    std::vector<uint16_t> half(32 * 64 * 64);
+    for (size_t i = 0; i < half.size(); ++i) {
+        half[i] = static_cast<uint16_t>(i % 65521);
+    }
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, half_shape, half.data(), &error), 0);
+
+    const int64_t region_origin[] = {3, 10, 17};
+    const int64_t region_shape[] = {20, 30, 40};
+    std::vector<uint16_t> region(20 * 30 * 40);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), region_origin, region_shape, region.data(), &error), 0);
+    for (int64_t z = 0; z < 20; ++z) {
+        for (int64_t y = 0; y < 30; ++y) {
+            for (int64_t x = 0; x < 40; ++x) {
+                const size_t source = ((z + 3) * 64 + (y + 10)) * 64 + (x + 17);
+                ASSERT_EQ(region[(z * 30 + y) * 40 + x], half[source]);
+            }
+        }
+    }
+
+    // Fortran-order destination
+    const int64_t fortran_strides[] = {2, 20 * 2, 20 * 30 * 2};
+    std::vector<uint16_t> fortran(region.size());
+    ASSERT_EQ(TSReadStrided(dataset.get(), region_origin, region_shape, fortran.data(),
+                            fortran_strides, &error), 0);
+    for (int64_t z = 0; z < 20; z += 3) {
+        for (int64_t y = 0; y < 30; y += 7) {
+            for (int64_t x = 0; x < 40; x += 5) {
+                EXPECT_EQ(fortran[(x * 30 + y) * 20 + z], region[(z * 30 + y) * 40 + x]);
+            }
+        }
+    }
+
+    std::vector<uint16_t> all(64 * 64 * 64, 1);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), origin, shape, all.data(), &error), 0);
+    EXPECT_TRUE(std::equal(half.begin(), half.end(), all.begin()));
+    EXPECT_TRUE(std::all_of(all.begin() + half.size(), all.end(),
+                            [](uint16_t v) { return v == 0; }));
+
+    // Chunks rewritten through another handle are remapped
+    TSDatasetPtr writer(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ_WRITE, &error));
+    ASSERT_NE(writer, nullptr);
+    std::vector<uint16_t> sevens(region.size(), 7);
+    ASSERT_EQ(TSWriteUInt16(writer.get(), region_origin, region_shape, sevens.data(), &error), 0);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), region_origin, region_shape, region.data(), &error), 0);
+    EXPECT_EQ(region, sevens);
+}
+
+// Test reads of uncompressed chunks through io_uring
+TEST_F(TensorStoreDLLTest, UringReads) {
+    TSContextOptions options{};
+    options.file_io_backend = TS_FILE_IO_URING;
+    context.reset(TSCreateContextWithOptions(&options, &error));
+    if (!context) {
+        TSClearError(&error);
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    // More chunks than fit in one batch, with a missing one at the end
+    const int64_t shape[] = {64, 64, 64};
+    const int64_t chunks[] = {8, 8, 16};
+    TSDatasetPtr dataset(TSCreateZarr(context.get(), test_file.c_str(), TS_UINT16, shape, 3,
+                                      chunks, 0, &error));
+    ASSERT_NE(dataset, nullptr);
+    const int64_t origin[] = {0, 0, 0};
+    const int64_t written_shape[] = {56, 64, 64};
+    std::vector<uint16_t> volume(64 * 64 * 64, 0);
+    for (size_t i = 0; i < 56 * 64 * 64; ++i) {
+        volume[i] = static_cast<uint16_t>(i % 65521);
+    }
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, written_shape, volume.data(), &error), 0);
+
+    std::vector<uint16_t> read_back(volume.size(), 1);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), origin, shape, read_back.data(), &error), 0);
+    EXPECT_EQ(read_back, volume);
+
+    const int64_t region_origin[] = {5, 9, 30};
+    const int64_t region_shape[] = {40, 21, 17};
+    std::vector<uint16_t> region(40 * 21 * 17);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), region_origin, region_shape, region.data(), &error), 0);
+    for (int64_t z = 0; z < 40; ++z) {
+        for (int64_t y = 0; y < 21; ++y) {
+            for (int64_t x = 0; x < 17; ++x) {
+                ASSERT_EQ(region[(z * 21 + y) * 17 + x],
+                          volume[((z + 5) * 64 + (y + 9)) * 64 + (x + 30)]);
+            }
+        }
+    }
+
+    // Reads from several threads use their own rings
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            std::vector<uint16_t> local(volume.size());
+            TSError local_error = {nullptr, 0};
+            if (TSReadUInt16(dataset.get(), origin, shape, local.data(), &local_error) != 0 ||
+                local != volume) {
+                ++failures;
+            }
+            TSClearError(&local_error);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(failures, 0);
+}
+
+// Test chunk-aligned writes that bypass the page cache
+TEST_F(TensorStoreDLLTest, DirectWrite) {
+    const int64_t shape[] = {64, 64, 60};
+    const int64_t chunks[] = {16, 16, 16};
+    const int64_t origin[] = {0, 0, 0};
+    std::vector<uint16_t> volume(64 * 64 * 60);
+    for (size_t i = 0; i < volume.size(); ++i) {
+        volume[i] = static_cast<uint16_t>(i % 3001);
+    }
+
+    for (int shard_size_mb : {0, 1}) {
+        std::filesystem::remove_all(test_file);
+        TSDatasetPtr dataset(TSCreateZarrCompressed(context.get(), test_file.c_str(), TS_UINT16,
+                                                    shape, 3, chunks, shard_size_mb, "zstd", 3,
+                                                    &error));
+        ASSERT_NE(dataset, nullptr);
+        if (TSSetDirectWrite(dataset.get(), 1, &error) != 0) {
+            TSClearError(&error);
+            GTEST_SKIP() << "Direct writes are not supported on this platform";
+        }
+
+        // Whole chunks, with the last ones clipped at the x bound
+        ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, shape, volume.data(), &error), 0)
+            << error.message;
+        // A partial write takes the regular path
+        const int64_t patch_origin[] = {5, 5, 5};
+        const int64_t patch_shape[] = {1, 1, 4};
+        const uint16_t patch[] = {9, 9, 9, 9};
+        ASSERT_EQ(TSWriteUInt16(dataset.get(), patch_origin, patch_shape, patch, &error), 0);
+        for (int64_t x = 5; x < 9; ++x) {
+            volume[(5 * 64 + 5) * 60 + x] = 9;
+        }
+
+        TSDatasetPtr reader(TSOpenZarr(context.get(), test_file.c_str(), TS_OPEN_READ, &error));
+        ASSERT_NE(reader, nullptr);
+        std::vector<uint16_t> read_back(volume.size());
+        ASSERT_EQ(TSReadUInt16(reader.get(), origin, shape, read_back.data(), &error), 0);
+        EXPECT_EQ(read_back, volume) << "shard_size_mb " << shard_size_mb;
+
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(test_file)) {
+            EXPECT_EQ(entry.path().string().find(".__direct_write"), std::string::npos);
+        }
+        EXPECT_EQ(TSSetDirectWrite(dataset.get(), 0, &error), 0);
+    }
+}
+
+// Test reading and writing through Fortran-order and padded layouts
+TEST_F(TensorStoreDLLTest, StridedIO) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    const int64_t origin[] = {0, 8, 16};
+    const int64_t region[] = {4, 10, 12};
+    std::vector<uint16_t> c_order(4 * 10 * 12);
+    for (size_t i = 0; i < c_order.size(); ++i) {
+        c_order[i] = static_cast<uint16_t>(i);
+    }
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, region, c_order.data(), &error), 0);
+
+    // Fortran order
+    const int64_t f_strides[] = {2, 2 * 4, 2 * 4 * 10};
+    std::vector<uint16_t> f_order(c_order.size());
+    ASSERT_EQ(TSReadStrided(dataset.get(), origin, region, f_order.data(),
+                            f_strides, &error), 0);
+    EXPECT_EQ(error.message, nullptr);
+    for (int64_t z = 0; z < 4; ++z) {
+        for (int64_t y = 0; y < 10; ++y) {
+            for (int64_t x = 0; x < 12; ++x) {
+                EXPECT_EQ(f_order[(x * 10 + y) * 4 + z], c_order[(z * 10 + y) * 12 + x]);
+            }
+        }
+    }
+
+    // Rows padded to 16 elements, written back and read in C order
+    const int64_t pitch = 16;
+    const int64_t padded_strides[] = {2 * pitch * 10, 2 * pitch, 2};
+    std::vector<uint16_t> padded(4 * 10 * pitch, 0xFFFF);
+    for (int64_t z = 0; z < 4; ++z) {
+        for (int64_t y = 0; y < 10; ++y) {
+            for (int64_t x = 0; x < 12; ++x) {
+                padded[(z * 10 + y) * pitch + x] = static_cast<uint16_t>(x + y + z);
+            }
+        }
+    }
+    ASSERT_EQ(TSWriteStrided(dataset.get(), origin, region, padded.data(),
+                             padded_strides, &error), 0);
+    std::vector<uint16_t> read_back(c_order.size());
+    ASSERT_EQ(TSReadUInt16(dataset.get(), origin, region, read_back.data(), &error), 0);
+    for (int64_t z = 0; z < 4; ++z) {
+        for (int64_t y = 0; y < 10; ++y) {
+            for (int64_t x = 0; x < 12; ++x) {
+                EXPECT_EQ(read_back[(z * 10 + y) * 12 + x], x + y + z);
+            }
+        }
+    }
+}
+
+// Test runtime metrics export
+TEST_F(TensorStoreDLLTest, Metrics) {
+    const int64_t shape[] = {64, 64, 64};
+    auto dataset = createTestDataset(shape, 3);
+    ASSERT_NE(dataset, nullptr);
+
+    const int64_t origin[] = {0, 0, 0};
+    const int64_t region[] = {32, 32, 32};
+    std::vector<uint16_t> data(32 * 32 * 32, 7);
+    ASSERT_EQ(TSWriteUInt16(dataset.get(), origin, region, data.data(), &error), 0);
+    ASSERT_EQ(TSReadUInt16(dataset.get(), origin, region, data.data(), &error), 0);
+
+    // Completion is recorded from a callback that may still be running on a
+    // worker thread, so allow it a moment to land
+    std::vector<char> json(1 << 20);
+    std::string metrics;
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(TSGetMetrics(context.get(), json.data(), json.size(), &error), 0);
+        metrics = json.data();
+        if (metrics.find("\"in_flight\":0") != std::string::npos) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(error.message, nullptr);
+    EXPECT_NE(metrics.find("\"read\""), std::string::npos);
+    EXPECT_NE(metrics.find("\"write\""), std::string::npos);
+    EXPECT_NE(metrics.find("\"bytes\":65536"), std::string::npos);
+    EXPECT_NE(metrics.find("\"in_flight\""), std::string::npos);
+    // Tensorstore's counters are listed, or null when the build leaves them out
+    const auto parsed = nlohmann::json::parse(metrics);
+    ASSERT_TRUE(parsed.contains("tensorstore"));
+    EXPECT_TRUE(parsed["tensorstore"].is_array() || parsed["tensorstore"].is_null());
+
+    char small[8];
+    EXPECT_NE(TSGetMetrics(context.get(), small, sizeof(small), &error), 0);
+    EXPECT_NE(error.message, nullptr);
+    TSClearError(&error);
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();